@@ -0,0 +1,334 @@
+#include "contour.h"
+#include "program.h"
+#include "view.h"
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#include <map>
+#include <string>
+
+using namespace std;
+using namespace Math;
+
+namespace {
+
+// an edge of the sampling lattice: from (a, b) to (a+1, b) if horizontal,
+// (a, b+1) if not
+struct EdgeId
+{
+  int a, b;
+  bool horiz;
+
+  EdgeId (void) {}
+  EdgeId (int a, int b, bool horiz)
+  { this->a = a; this->b = b; this->horiz = horiz; }
+
+  bool operator< (const EdgeId& other) const
+  {
+    if (a != other.a) return a < other.a;
+    if (b != other.b) return b < other.b;
+    return horiz < other.horiz;
+  }
+};
+
+struct Segment
+{
+  EdgeId e1, e2;
+  int out;
+  bool used;
+};
+
+class Marcher
+{
+  const Program& prog;
+  const View& view;
+  double step;                  // pixels between lattice points
+  int num_out;
+
+  vector< double > regs, out;
+  vector< double > values;      // num_out per sampled lattice point
+  map< pair< int, int >, int > sampled;
+
+public:
+  vector< Segment > segments;
+
+  Marcher (const Program& prog, const View& view, double step)
+    : prog (prog), view (view), regs (prog.get_num_nodes()),
+      out (prog.get_num_outputs())
+  {
+    this->step = step;
+    num_out = prog.get_num_outputs();
+  }
+
+  const double *sample (int a, int b);
+  ContourPoint edge_point (const EdgeId& e, int k);
+  void refine (int a, int b, int size, int k);
+  void march (int a, int b, int k);
+};
+
+const double *
+Marcher::sample (int a, int b)
+{
+  pair< int, int > key (a, b);
+  map< pair< int, int >, int >::iterator it = sampled.find (key);
+  if (it != sampled.end())
+    return &values[ it->second ];
+
+  double x_y[2];
+  x_y[0] = view.horiz_px_to_pt (a * step);
+  x_y[1] = view.vert_px_to_pt  (b * step);
+  prog (x_y, &regs[0], &out[0]);
+
+  int pos = values.size();
+  values.insert (values.end(), out.begin(), out.end());
+  sampled[ key ] = pos;
+
+  return &values[ pos ];
+}
+
+// where output k crosses zero on e. Always interpolated from the same
+// end, so both cells sharing e get exactly the same point.
+ContourPoint
+Marcher::edge_point (const EdgeId& e, int k)
+{
+  int a2 = e.horiz ? e.a + 1 : e.a;
+  int b2 = e.horiz ? e.b : e.b + 1;
+
+  double v1 = sample (e.a, e.b)[k];
+  double v2 = sample (a2, b2)[k];
+  double t  = v1 / (v1 - v2);
+
+  ContourPoint p;
+  p.x = (e.a + t * (a2 - e.a)) * step;
+  p.y = (e.b + t * (b2 - e.b)) * step;
+  return p;
+}
+
+static bool
+changes_sign (double v1, double v2, double v3, double v4)
+{
+  if (isnan (v1) || isnan (v2) || isnan (v3) || isnan (v4))
+    return false;
+
+  bool pos = (v1 >= 0.0);
+  return (v2 >= 0.0) != pos || (v3 >= 0.0) != pos || (v4 >= 0.0) != pos;
+}
+
+void
+Marcher::refine (int a, int b, int size, int k)
+{
+  if (!changes_sign (sample (a, b)[k],        sample (a + size, b)[k],
+                     sample (a + size, b + size)[k], sample (a, b + size)[k]))
+    return;
+
+  if (size == 1)
+  {
+    march (a, b, k);
+    return;
+  }
+
+  int half = size / 2;
+  refine (a,        b,        half, k);
+  refine (a + half, b,        half, k);
+  refine (a,        b + half, half, k);
+  refine (a + half, b + half, half, k);
+}
+
+// one marching squares cell, corners c0..c3 going around from (a, b)
+void
+Marcher::march (int a, int b, int k)
+{
+  double v[4];
+  v[0] = sample (a,     b)[k];
+  v[1] = sample (a + 1, b)[k];
+  v[2] = sample (a + 1, b + 1)[k];
+  v[3] = sample (a,     b + 1)[k];
+
+  // edge i goes from corner i to corner i+1
+  EdgeId edges[4];
+  edges[0] = EdgeId (a,     b,     true);
+  edges[1] = EdgeId (a + 1, b,     false);
+  edges[2] = EdgeId (a,     b + 1, true);
+  edges[3] = EdgeId (a,     b,     false);
+
+  int crossed[4], num_crossed = 0;
+  for (int i = 0; i < 4; i++)
+    if ((v[i] >= 0.0) != (v[ (i + 1) % 4 ] >= 0.0))
+      crossed[ num_crossed++ ] = i;
+
+  Segment s;
+  s.out  = k;
+  s.used = false;
+
+  if (num_crossed == 2)
+  {
+    s.e1 = edges[ crossed[0] ];
+    s.e2 = edges[ crossed[1] ];
+    segments.push_back (s);
+    return;
+  }
+
+  // a saddle: the value in the middle decides which corners are joined
+  double center = (v[0] + v[1] + v[2] + v[3]) / 4;
+  int first = ((center >= 0.0) == (v[0] >= 0.0)) ? 1 : 0;
+
+  // cut off corners 'first' and 'first' + 2
+  s.e1 = edges[ (first + 3) % 4 ];
+  s.e2 = edges[ first ];
+  segments.push_back (s);
+
+  s.e1 = edges[ (first + 1) % 4 ];
+  s.e2 = edges[ (first + 2) % 4 ];
+  segments.push_back (s);
+}
+
+} // namespace
+
+vector< Polyline >
+extract_contours (const Program& prog, const View& view,
+                  int coarse, double fine)
+{
+  int levels = 0;
+  while (((double)coarse) / (1 << levels) > fine && levels < 16)
+    levels++;
+
+  int size = 1 << levels;
+  Marcher m (prog, view, ((double)coarse) / size);
+
+  int cells_x = (view.width  + coarse - 1) / coarse;
+  int cells_y = (view.height + coarse - 1) / coarse;
+
+  for (int k = 0; k < prog.get_num_outputs(); k++)
+    for (int cy = 0; cy < cells_y; cy++)
+      for (int cx = 0; cx < cells_x; cx++)
+        m.refine (cx * size, cy * size, size, k);
+
+  // join the segments that share an edge into polylines
+  vector< Segment >& segs = m.segments;
+  map< pair< EdgeId, int >, vector< int > > at_edge;
+  for (int i = 0; i < segs.size(); i++)
+  {
+    at_edge[ make_pair (segs[i].e1, segs[i].out) ].push_back (i);
+    at_edge[ make_pair (segs[i].e2, segs[i].out) ].push_back (i);
+  }
+
+  vector< Polyline > lines;
+  for (int i = 0; i < segs.size(); i++)
+  {
+    if (segs[i].used)
+      continue;
+
+    segs[i].used = true;
+    int k = segs[i].out;
+
+    // walk forwards from e2, then backwards from e1
+    vector< EdgeId > fwd (1, segs[i].e2), bwd (1, segs[i].e1);
+    for (int dir = 0; dir < 2; dir++)
+    {
+      vector< EdgeId >& chain = dir ? bwd : fwd;
+      for (;;)
+      {
+        vector< int >& next = at_edge[ make_pair (chain.back(), k) ];
+        int j;
+        for (j = 0; j < next.size() && segs[ next[j] ].used; j++)
+          ;
+        if (j == next.size())
+          break;
+
+        Segment& s = segs[ next[j] ];
+        s.used = true;
+        chain.push_back ((s.e1 < chain.back() || chain.back() < s.e1) ?
+                         s.e1 : s.e2);
+      }
+    }
+
+    vector< EdgeId > chain (bwd.rbegin(), bwd.rend());
+    chain.insert (chain.end(), fwd.begin(), fwd.end());
+
+    // a curve through a lattice point crosses two edges there
+    Polyline line;
+    for (int j = 0; j < chain.size(); j++)
+    {
+      ContourPoint p = m.edge_point (chain[j], k);
+      if (line.empty() || p.x != line.back().x || p.y != line.back().y)
+        line.push_back (p);
+    }
+
+    lines.push_back (line);
+  }
+
+  return lines;
+}
+
+void
+write_svg (FILE *f, const View& view, const vector< Polyline >& lines)
+{
+  fprintf (f, "<?xml version=\"1.0\" standalone=\"no\"?>\n");
+  fprintf (f, "<svg xmlns=\"http://www.w3.org/2000/svg\" "
+              "width=\"%d\" height=\"%d\" viewBox=\"0 0 %d %d\">\n",
+           view.width, view.height, view.width, view.height);
+  fprintf (f, "<rect width=\"%d\" height=\"%d\" fill=\"black\"/>\n",
+           view.width, view.height);
+
+  for (int i = 0; i < lines.size(); i++)
+  {
+    const Polyline& line = lines[i];
+
+    fprintf (f, "<path fill=\"none\" stroke=\"red\" d=\"");
+    for (int j = 0; j < line.size(); j++)
+      fprintf (f, "%c%.2f %.2f", j ? 'L' : 'M', line[j].x, line[j].y);
+    fprintf (f, "\"/>\n");
+  }
+
+  fprintf (f, "</svg>\n");
+}
+
+void
+write_pdf (FILE *f, const View& view, const vector< Polyline >& lines)
+{
+  char buf[128];
+
+  // the page, black with red curves; PDF's y axis points up
+  string content;
+  sprintf (buf, "0 0 0 rg 0 0 %d %d re f\n1 0 0 RG 1 w\n",
+           view.width, view.height);
+  content += buf;
+
+  for (int i = 0; i < lines.size(); i++)
+  {
+    const Polyline& line = lines[i];
+    for (int j = 0; j < line.size(); j++)
+    {
+      sprintf (buf, "%.2f %.2f %c\n", line[j].x, view.height - line[j].y,
+               j ? 'l' : 'm');
+      content += buf;
+    }
+    content += "S\n";
+  }
+
+  vector< long > offsets;
+  fprintf (f, "%%PDF-1.4\n");
+
+  offsets.push_back (ftell (f));
+  fprintf (f, "1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+
+  offsets.push_back (ftell (f));
+  fprintf (f, "2 0 obj\n<< /Type /Pages /Kids [3 0 R] /Count 1 >>\nendobj\n");
+
+  offsets.push_back (ftell (f));
+  fprintf (f, "3 0 obj\n<< /Type /Page /Parent 2 0 R "
+              "/MediaBox [0 0 %d %d] /Contents 4 0 R >>\nendobj\n",
+           view.width, view.height);
+
+  offsets.push_back (ftell (f));
+  fprintf (f, "4 0 obj\n<< /Length %d >>\nstream\n%sendstream\nendobj\n",
+           (int)content.size(), content.c_str());
+
+  long xref = ftell (f);
+  fprintf (f, "xref\n0 %d\n0000000000 65535 f \n", (int)offsets.size() + 1);
+  for (int i = 0; i < offsets.size(); i++)
+    fprintf (f, "%010ld 00000 n \n", offsets[i]);
+
+  fprintf (f, "trailer\n<< /Size %d /Root 1 0 R >>\nstartxref\n%ld\n%%%%EOF\n",
+           (int)offsets.size() + 1, xref);
+}
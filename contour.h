@@ -0,0 +1,33 @@
+#ifndef _CONTOUR_H_
+#define _CONTOUR_H_
+
+#include <stdio.h>
+#include <vector>
+#include "program.h"
+#include "view.h"
+
+// a point in the pixel coordinates of a View
+struct ContourPoint
+{
+  double x, y;
+};
+
+typedef std::vector< ContourPoint > Polyline;
+
+// The zero sets of all of prog's outputs over view, as polylines. They
+// are found with marching squares, starting from cells of coarse x coarse
+// pixels; only the cells whose corners change sign are split, down to
+// cells of about 'fine' pixels, so the number of evaluations follows the
+// length of the curves rather than the area of the view.
+std::vector< Polyline > extract_contours (const Math::Program& prog,
+                                          const View& view,
+                                          int coarse = 16,
+                                          double fine = 0.5);
+
+// vector output, in the view's pixel coordinates
+void write_svg (FILE *f, const View& view,
+                const std::vector< Polyline >& lines);
+void write_pdf (FILE *f, const View& view,
+                const std::vector< Polyline >& lines);
+
+#endif
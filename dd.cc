@@ -0,0 +1,195 @@
+#include "dd.h"
+#include "func.h"
+#include <math.h>
+
+namespace Math {
+
+#ifndef LN_10
+#define LN_10  2.302585093
+#endif
+
+DoubleDouble
+two_sum (double a, double b)
+{
+  double s  = a + b;
+  double bb = s - a;
+  return DoubleDouble (s, (a - (s - bb)) + (b - bb));
+}
+
+// a + b, exactly, when |a| >= |b|
+static DoubleDouble
+quick_two_sum (double a, double b)
+{
+  double s = a + b;
+  return DoubleDouble (s, b - (s - a));
+}
+
+// Dekker's split: a == hi + lo, each with at most 26 significant bits
+static void
+split (double a, double& hi, double& lo)
+{
+  double t = 134217729.0 * a;   // 2^27 + 1
+  hi = t - (t - a);
+  lo = a - hi;
+}
+
+// a * b, exactly
+static DoubleDouble
+two_prod (double a, double b)
+{
+  double p = a * b;
+  double a_hi, a_lo, b_hi, b_lo;
+  split (a, a_hi, a_lo);
+  split (b, b_hi, b_lo);
+
+  double err = ((a_hi * b_hi - p) + a_hi * b_lo + a_lo * b_hi) + a_lo * b_lo;
+  return DoubleDouble (p, err);
+}
+
+// the error terms are inf - inf once a result or a split overflows, so
+// where a result isn't finite, the answer is what double would have said
+static DoubleDouble
+or_double (const DoubleDouble& a, double d)
+{
+  return (finite (a.hi) && finite (a.lo)) ? a : DoubleDouble (d);
+}
+
+DoubleDouble
+operator+ (const DoubleDouble& a, const DoubleDouble& b)
+{
+  DoubleDouble s = two_sum (a.hi, b.hi);
+  DoubleDouble t = two_sum (a.lo, b.lo);
+  s.lo += t.hi;
+  s = quick_two_sum (s.hi, s.lo);
+  s.lo += t.lo;
+  return or_double (quick_two_sum (s.hi, s.lo), a.hi + b.hi);
+}
+
+DoubleDouble
+operator- (const DoubleDouble& a, const DoubleDouble& b)
+{
+  return a + DoubleDouble (-b.hi, -b.lo);
+}
+
+DoubleDouble
+operator* (const DoubleDouble& a, const DoubleDouble& b)
+{
+  DoubleDouble p = two_prod (a.hi, b.hi);
+  p.lo += a.hi * b.lo + a.lo * b.hi;
+  return or_double (quick_two_sum (p.hi, p.lo), a.hi * b.hi);
+}
+
+DoubleDouble
+operator/ (const DoubleDouble& a, const DoubleDouble& b)
+{
+  double q1 = a.hi / b.hi;
+  DoubleDouble r = a - b * DoubleDouble (q1);
+
+  double q2 = r.hi / b.hi;
+  r = r - b * DoubleDouble (q2);
+
+  double q3 = r.hi / b.hi;
+  DoubleDouble q = quick_two_sum (q1, q2);
+  return or_double (q + DoubleDouble (q3), q1);
+}
+
+static DoubleDouble
+dd_sqrt (const DoubleDouble& a)
+{
+  if (a.hi <= 0.0)
+    return DoubleDouble (sqrt (a.hi));
+
+  // one Newton step from the double root
+  double q = sqrt (a.hi);
+  DoubleDouble r = a - two_prod (q, q);
+  return or_double (quick_two_sum (q, r.hi / (2.0 * q)), q);
+}
+
+static DoubleDouble
+dd_pow (const DoubleDouble& a, const DoubleDouble& b)
+{
+  // small integer powers, like x^2, by multiplying
+  if (b.lo == 0.0 && b.hi == floor (b.hi) && fabs (b.hi) <= 16.0)
+  {
+    int n = (int) fabs (b.hi);
+    DoubleDouble ans (1.0), base = a;
+    for (; n; n >>= 1)
+    {
+      if (n & 1)
+        ans = ans * base;
+      base = base * base;
+    }
+    ans = (b.hi < 0.0) ? DoubleDouble (1.0) / ans : ans;
+    return or_double (ans, pow (a.hi, b.hi));
+  }
+
+  // d(a^b) = a^b * (b/a da + ln(a) db)
+  double p = pow (a.hi, b.hi);
+  return or_double (quick_two_sum (p, p * (b.hi * a.lo / a.hi +
+                                           log (a.hi) * b.lo)), p);
+}
+
+// f' of the unary operations, for the first order term
+static double
+unary_deriv (ops_enum op, double d)
+{
+  switch (op)
+  {
+    case op_sin:   return cos (d);
+    case op_cos:   return -sin (d);
+    case op_tan:   return 1.0 / (cos (d) * cos (d));
+    case op_csc:   return -cos (d) / (sin (d) * sin (d));
+    case op_sec:   return sin (d) / (cos (d) * cos (d));
+    case op_cot:   return -1.0 / (sin (d) * sin (d));
+    case op_asin:  return 1.0 / sqrt (1.0 - d*d);
+    case op_acos:  return -1.0 / sqrt (1.0 - d*d);
+    case op_atan:  return 1.0 / (1.0 + d*d);
+    case op_acsc:  return -1.0 / (fabs (d) * sqrt (d*d - 1.0));
+    case op_asec:  return 1.0 / (fabs (d) * sqrt (d*d - 1.0));
+    case op_acot:  return -1.0 / (1.0 + d*d);
+    case op_sinh:  return cosh (d);
+    case op_cosh:  return sinh (d);
+    case op_tanh:  return 1.0 / (cosh (d) * cosh (d));
+    case op_csch:  return -cosh (d) / (sinh (d) * sinh (d));
+    case op_sech:  return -sinh (d) / (cosh (d) * cosh (d));
+    case op_coth:  return -1.0 / (sinh (d) * sinh (d));
+    case op_asinh: return 1.0 / sqrt (d*d + 1.0);
+    case op_acosh: return 1.0 / sqrt (d*d - 1.0);
+    case op_atanh: return 1.0 / (1.0 - d*d);
+    case op_acsch: return -1.0 / (fabs (d) * sqrt (1.0 + d*d));
+    case op_asech: return -1.0 / (d * sqrt (1.0 - d*d));
+    case op_acoth: return 1.0 / (1.0 - d*d);
+    case op_log:   return 1.0 / (d * LN_10);
+    case op_ln:    return 1.0 / d;
+    case op_exp:   return exp (d);
+    case op_abs:   return (d < 0.0) ? -1.0 : 1.0;
+    default:       break;
+  }
+
+  return 0.0;
+}
+
+DoubleDouble
+eval_op (ops_enum op, const DoubleDouble& arg1, const DoubleDouble& arg2)
+{
+  switch (op)
+  {
+    case op_plus:  return arg1 + arg2;
+    case op_minus: return arg1 - arg2;
+    case op_div:   return (arg1.hi == 0.0) ? DoubleDouble (0.0) : arg1 / arg2;
+    case op_mult:  return (arg1.hi == 0.0 || arg2.hi == 0.0) ?
+                            DoubleDouble (0.0) : arg1 * arg2;
+    case op_pow:   return dd_pow (arg1, arg2);
+    case op_sqrt:  return dd_sqrt (arg1);
+    default:       break;
+  }
+
+  double f = eval_op (op, arg1.hi);
+  if (arg1.lo == 0.0 || !finite (f))
+    return DoubleDouble (f);
+
+  return or_double (quick_two_sum (f, unary_deriv (op, arg1.hi) * arg1.lo),
+                    f);
+}
+
+} // namespace Math
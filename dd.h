@@ -0,0 +1,41 @@
+#ifndef _DD_H_
+#define _DD_H_
+
+#include "func.h"
+
+namespace Math
+{
+  // "double-double": the unevaluated sum hi + lo, |lo| <= ulp(hi) / 2,
+  // good for about 106 bits. Used where a view is zoomed in so far that
+  // neighbouring pixels have the same coordinates in double.
+  struct DoubleDouble
+  {
+    double hi, lo;
+
+    DoubleDouble (void) {}
+    DoubleDouble (double hi, double lo = 0.0)
+    {
+      this->hi = hi;
+      this->lo = lo;
+    }
+
+    double to_double (void) const { return hi + lo; }
+  };
+
+  DoubleDouble operator+ (const DoubleDouble& a, const DoubleDouble& b);
+  DoubleDouble operator- (const DoubleDouble& a, const DoubleDouble& b);
+  DoubleDouble operator* (const DoubleDouble& a, const DoubleDouble& b);
+  DoubleDouble operator/ (const DoubleDouble& a, const DoubleDouble& b);
+
+  // a + b, exactly
+  DoubleDouble two_sum (double a, double b);
+
+  // eval_op in double-double. The libm functions only exist in double, so
+  // f (hi + lo) is taken as f (hi) + f'(hi) * lo: the result is as good
+  // as f (hi), but still changes smoothly with lo, which is what keeps a
+  // deeply zoomed curve from falling apart into noise.
+  DoubleDouble eval_op (ops_enum op, const DoubleDouble& arg1,
+                        const DoubleDouble& arg2);
+}
+
+#endif
@@ -410,7 +410,7 @@ acot_rule (const vector< Variant >& RPN, var_enum differential, int top_pos)
   ret.push_back (op_pow);
 
   // push op_plus
-  ret.push_back (op_minus);
+  ret.push_back (op_plus);
  
   // push op_div
   ret.push_back (op_div);
@@ -863,7 +863,7 @@ sqrt_rule (const vector< Variant >& RPN, var_enum differential, int top_pos)
 
 static vector< Variant >
 abs_rule (const vector< Variant >& RPN, var_enum differential, int top_pos)
-{ // arg * deriv(arg) / abs(arg)
+{ // arg / abs(arg) * deriv(arg)
   vector< Variant > ret;
   
   int arg_bottom = find_arg_bottom (RPN, top_pos - 1);
@@ -871,19 +871,20 @@ abs_rule (const vector< Variant >& RPN, var_enum differential, int top_pos)
   // push "arg"
   ret.insert (ret.end(), RPN.begin() + arg_bottom, RPN.begin() + top_pos);
 
+  // push "abs (arg)"
+  ret.insert (ret.end(), RPN.begin() + arg_bottom, RPN.begin() + top_pos);
+  ret.push_back (op_abs);
+  
+  // push op_div; taking the sign first keeps arg * deriv(arg) from
+  // underflowing to 0 for tiny args
+  ret.push_back (op_div);
+
   // push "deriv (arg)"
   vector< Variant > chain_rule = rpn_deriv (RPN, differential, top_pos - 1);
   ret.insert (ret.end(), chain_rule.begin(), chain_rule.end());
   
   // push op_mult
   ret.push_back (op_mult);
-  
-  // push "abs (arg)"
-  ret.insert (ret.end(), RPN.begin() + arg_bottom, RPN.begin() + top_pos);
-  ret.push_back (op_abs);
-  
-  // push op_div
-  ret.push_back (op_div);
 
   return ret;
 }
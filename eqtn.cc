@@ -0,0 +1,111 @@
+#include "eqtn.h"
+#include "func.h"
+#include <vector>
+#include <string>
+
+using namespace std;
+using namespace Math;
+
+bool
+depends_on (const Function& f, var_enum var)
+{
+  vector< Variant > RPN = f.get_rpn_stack();
+  for (int i = 0; i < RPN.size(); i++)
+    if (RPN[i].type == Variant::VARIABLE && RPN[i].var == var)
+      return true;
+
+  return false;
+}
+
+param_set
+used_params (const vector< Function >& funcs)
+{
+  param_set used = NO_PARAMS;
+  for (int i = 0; i < funcs.size(); i++)
+  {
+    vector< Variant > RPN = funcs[i].get_rpn_stack();
+    for (int k = 0; k < RPN.size(); k++)
+      if (RPN[k].type == Variant::VARIABLE && is_param (RPN[k].var))
+        used |= param_bit (RPN[k].var);
+  }
+  return used;
+}
+
+Function
+implicit_form (const Function& g)
+{
+  vector< Variant > RPN (1, Variant (var_y));
+  vector< Variant > g_RPN = g.get_rpn_stack();
+
+  RPN.insert (RPN.end(), g_RPN.begin(), g_RPN.end());
+  RPN.push_back (op_minus);
+
+  return Function::FromRPN (RPN);
+}
+
+void
+compile_equations (string& text, vector< Function >& F, vector< Function >& Y,
+                   param_set params)
+  throw (SyntaxException, ArgumentException)
+{
+  vector< string > eqtns;
+
+  // several equations can be overlaid, separated by ';'
+  int start = 0, end;
+  do
+  {
+    end = text.find (';', start);
+    eqtns.push_back (text.substr (start, (end == string::npos) ?
+                                         string::npos : end - start));
+    start = end + 1;
+  } while (end != string::npos);
+
+  bool text_changed = false;
+  for (int i = 0; i < eqtns.size(); i++)
+  {
+    // make sure there's an equal sign
+    if (eqtns[i].find ('=') == string::npos)
+    {
+      int first = eqtns[i].find_first_not_of (' ');
+      eqtns[i].insert ((first == string::npos) ? 0 : first, "y = ");
+      text_changed = true;
+    }
+  }
+
+  if (text_changed)
+  {
+    text = eqtns[0];
+    for (int i = 1; i < eqtns.size(); i++)
+      text += ";" + eqtns[i];
+  }
+
+  for (int i = 0; i < eqtns.size(); i++)
+  {
+    string eqtn = eqtns[i];
+    int equal_sign_pos = eqtn.find ('=');
+
+    // "y = f(x)" can be traced instead of tested at every pixel
+    string lhs = eqtn.substr (0, equal_sign_pos);
+    string rhs = eqtn.substr (equal_sign_pos + 1);
+    lhs.erase (0, lhs.find_first_not_of (' '));
+    lhs.erase (lhs.find_last_not_of (' ') + 1);
+
+    if (lhs == "y" && rhs.find ('=') == string::npos)
+    {
+      Function f (rhs, params);
+      if (!depends_on (f, var_y))
+      {
+        Y.push_back (f);
+        continue;
+      }
+    }
+
+    // create the 3-D explicit function "F"
+    // f(x,y) = g(x,y)  -->  F(x,y) = f(x,y) - g(x,y)
+    eqtn [equal_sign_pos] = '-';
+    eqtn.insert (equal_sign_pos + 1, 1, '(');
+    eqtn.append (1, ')');
+
+    F.push_back (Function (eqtn, params));
+  }
+}
@@ -0,0 +1,28 @@
+#ifndef _EQTN_H_
+#define _EQTN_H_
+
+#include <vector>
+#include <string>
+#include "func.h"
+
+// Compiles "eq1; eq2; ..." where each equation is "f(x,y) = g(x,y)".
+// Equations of the form "y = g(x)" go into Y as g, the rest into F as
+// F(x,y) = f(x,y) - g(x,y). An equation without '=' is taken to be
+// "y = ...", and text is rewritten that way before anything is parsed.
+// The equations may use the parameters in params; any other letter is a
+// syntax error.
+void compile_equations (std::string& text,
+                        std::vector< Math::Function >& F,
+                        std::vector< Math::Function >& Y,
+                        Math::param_set params = Math::NO_PARAMS)
+  throw (Math::SyntaxException, Math::ArgumentException);
+
+// "y = g(x)" as F(x,y) = y - g(x)
+Math::Function implicit_form (const Math::Function& g);
+
+bool depends_on (const Math::Function& f, Math::var_enum var);
+
+// the parameters any of funcs uses
+Math::param_set used_params (const std::vector< Math::Function >& funcs);
+
+#endif
@@ -0,0 +1,673 @@
+/*
+ * eval_fuzz: checks every evaluator against Function, on random
+ * expressions.
+ *
+ *   eval_fuzz [-n expressions] [-p points] [-s seed] [-d depth]
+ *             [-u max_ulps] [-v]
+ *
+ * Expressions are generated from the grammar parse.cc accepts: numbers,
+ * x and y, the infix operations, every function, parentheses, unary
+ * minus, implied multiplication ("2x", "x(y+1)") and deriv(). Each is
+ * evaluated at random points by
+ *
+ *   program   Program::operator(), the whole DAG at once
+ *   stages    Program::eval_stage(), the way the renderer hoists
+ *   batch     Program::eval_batch() in double
+ *   float     the same in float, compared in float ulps
+ *   dd        eval_stage() in DoubleDouble, rounded to double
+ *
+ * and compared with Function::operator(): how many ulps apart, and where
+ * one gives NaN or an infinity and the other doesn't. Interval bounds at
+ * the point and over a box around it must hold Function's value. Both
+ * derivatives are checked against central differences wherever those
+ * agree with themselves at three step sizes, i.e. where f is smooth, and
+ * nothing on the way overflows or cancels; a mismatch only counts if it
+ * is there at points further away as well.
+ *
+ * Fails if program, stages or batch are more than max_ulps (default 0)
+ * off, if an interval misses, or if a derivative is wrong. float and dd
+ * are expected to differ in value, which is only reported, but not to
+ * give NaN or an infinity where Function doesn't, or the reverse, but
+ * where rounding leads them there. Those are counted as "rounded":
+ *
+ *   - an argument rounded across the edge of a domain, e.g. a sum a hair
+ *     over 1 going into asin, or a pole hit exactly in one precision;
+ *   - an overflow past float's range, of a constant or a result;
+ *   - an underflow to 0 that is then divided by.
+ *
+ * Any other disagreement fails: some operation, given the same
+ * arguments, came to NaN or an infinity in one and not in the other.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <float.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "func.h"
+#include "parse.h"
+#include "program.h"
+#include "dd.h"
+#include "interval.h"
+
+using namespace std;
+using namespace Math;
+
+static unsigned long long seed = 1;
+
+static unsigned
+random_bits (void)
+{
+  seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  return (unsigned) (seed >> 33);
+}
+
+static int
+random_int (int n)
+{
+  return random_bits() % n;
+}
+
+static double
+random_real (double lo, double hi)
+{
+  return lo + (hi - lo) * (random_bits() / 2147483648.0);
+}
+
+// a random expression, at most depth operations deep
+static string
+random_expr (int depth)
+{
+  if (depth <= 0 || random_int (4) == 0)
+  { // a leaf
+    char buf[ 32 ];
+    switch (random_int (6))
+    {
+      case 0: return "x";
+      case 1: return "y";
+      case 2: sprintf (buf, "%d", random_int (10)); return buf;
+      case 3: sprintf (buf, "%d.%d", random_int (10), random_int (100));
+              return buf;
+      case 4: sprintf (buf, ".%d", 1 + random_int (9)); return buf;
+      default: return random_int (2) ? "xy" : "2x";
+    }
+  }
+
+  static const char *infix[] = { "+", "-", "*", "/", "^" };
+
+  switch (random_int (10))
+  {
+    case 0: case 1: case 2: case 3:
+      return random_expr (depth - 1) + infix[ random_int (5) ] +
+             random_expr (depth - 1);
+
+    case 4: case 5: case 6:
+      { // sin( ... abs(
+        int op = random_int (op_abs + 1);
+        return op_names[ op ] + random_expr (depth - 1) + ")";
+      }
+
+    case 7:
+      return "(-" + random_expr (depth - 1) + ")";
+
+    case 8:
+      { // implied multiplication by a parenthesized factor
+        string factor = "(" + random_expr (depth - 1) + ")";
+        return (random_int (2) ? "3" : "x") + factor;
+      }
+
+    default:
+      if (random_int (4) == 0)
+        return string ("deriv(") + random_expr (min (depth - 1, 2)) +
+               (random_int (2) ? ",x)" : ",y)");
+      return "(" + random_expr (depth - 1) + ")";
+  }
+}
+
+// ulps between two finite doubles of the same or different signs
+static double
+ulps (double a, double b)
+{
+  long long ia, ib;
+  memcpy (&ia, &a, sizeof (ia));
+  memcpy (&ib, &b, sizeof (ib));
+  if (ia < 0) ia = (long long) 0x8000000000000000ULL - ia;
+  if (ib < 0) ib = (long long) 0x8000000000000000ULL - ib;
+  return fabs ((double) ia - (double) ib);
+}
+
+static double
+ulps (float a, float b)
+{
+  int ia, ib;
+  memcpy (&ia, &a, sizeof (ia));
+  memcpy (&ib, &b, sizeof (ib));
+  if (ia < 0) ia = (int) 0x80000000U - ia;
+  if (ib < 0) ib = (int) 0x80000000U - ib;
+  return fabs ((double) ia - (double) ib);
+}
+
+enum backend_enum
+{
+  BACKEND_PROGRAM,
+  BACKEND_STAGES,
+  BACKEND_BATCH,
+  BACKEND_FLOAT,
+  BACKEND_DD,
+  NUM_BACKENDS
+};
+
+static const char *backend_names[ NUM_BACKENDS ] =
+{ "program", "stages", "batch", "float", "dd" };
+
+struct Tally
+{
+  long compared, exact, over;       // over: more than max_ulps apart
+  long nan_mismatches, inf_mismatches;
+  long rounded;                     // mismatches rounding explains
+  double worst;
+  string worst_expr;
+  double worst_x, worst_y, worst_ref, worst_val;
+};
+
+static bool verbose = false;
+
+// what a value is, as far as NaN and Inf mismatches go
+enum value_class_enum { FINITE, PLUS_INFINITE, MINUS_INFINITE, UNDEFINED };
+
+static value_class_enum
+value_class (double v)
+{
+  if (isnan (v))
+    return UNDEFINED;
+  if (isinf (v))
+    return (v > 0.0) ? PLUS_INFINITE : MINUS_INFINITE;
+  return FINITE;
+}
+
+static value_class_enum
+value_class (const DoubleDouble& v)
+{
+  return value_class (v.hi);
+}
+
+// whether v is exactly the reference's r
+static bool
+same_value (double r, float v)
+{
+  return (double) v == r || (isnan (r) && isnan (v));
+}
+
+static bool
+same_value (double r, const DoubleDouble& v)
+{
+  return (v.hi == r && v.lo == 0.0) || (isnan (r) && isnan (v.hi));
+}
+
+static double largest (float)               { return FLT_MAX; }
+static double largest (const DoubleDouble&) { return DBL_MAX; }
+
+// Whether rounding explains the backend's NaN or infinity where the
+// reference has none, or the other way around (see the top). ref and val
+// are the values of every node of prog, node k's at k * stride. Looked
+// at are the nodes where the two part ways, coming to a different kind
+// of value while their arguments didn't: each must be a constant, or a
+// value beyond the backend's range, or have been given arguments that
+// were already different numbers.
+template < class T >
+static bool
+rounding_explains (const Program& prog, const double *ref, const T *val,
+                   int stride)
+{
+  bool found = false;
+  for (int k = 0; k < prog.get_num_nodes(); k++)
+  {
+    double r = ref[ k * stride ];
+    const T& v = val[ k * stride ];
+    if (value_class (r) == value_class (v))
+      continue;
+
+    const Program::Node& n = prog.get_node (k);
+    int args[2] = { n.arg1, n.arg2 };
+    bool args_agree = true, args_same = true;
+    for (int a = 0; a < 2; a++)
+      if (args[a] >= 0)
+      {
+        double ra = ref[ args[a] * stride ];
+        const T& va = val[ args[a] * stride ];
+        args_agree = args_agree && value_class (ra) == value_class (va);
+        args_same = args_same && same_value (ra, va);
+      }
+    if (!args_agree)
+      continue;   // only passed on
+
+    found = true;
+    bool constant = (n.arg1 < 0);
+    bool overflow = isfinite (r) && fabs (r) > largest (v);
+    if (!constant && !overflow && args_same)
+      return false;
+  }
+  return found;
+}
+
+// rounded: whether, if ref and val are a NaN or Inf mismatch, rounding
+// explains it
+static void
+compare (Tally& t, backend_enum b, double ref, double val, double max_ulps,
+         const string& expr, double x, double y, bool rounded = false)
+{
+  t.compared++;
+
+  bool ref_nan = isnan (ref), val_nan = isnan (val);
+  if (ref_nan || val_nan)
+  {
+    if (ref_nan != val_nan && rounded)
+      t.rounded++;
+    else if (ref_nan != val_nan)
+    {
+      t.nan_mismatches++;
+      if (verbose)
+        printf ("%s NaN mismatch: %s at (%.17g, %.17g): %.17g vs %.17g\n",
+                backend_names[b], expr.c_str(), x, y, ref, val);
+    }
+    else
+      t.exact++;
+    return;
+  }
+
+  if (isinf (ref) || isinf (val))
+  {
+    if (ref != val && rounded)
+      t.rounded++;
+    else if (ref != val)
+    {
+      t.inf_mismatches++;
+      if (verbose)
+        printf ("%s Inf mismatch: %s at (%.17g, %.17g): %.17g vs %.17g\n",
+                backend_names[b], expr.c_str(), x, y, ref, val);
+    }
+    else
+      t.exact++;
+    return;
+  }
+
+  double d = (b == BACKEND_FLOAT) ? ulps ((float) ref, (float) val)
+                                  : ulps (ref, val);
+  if (d == 0)
+    t.exact++;
+  if (d > max_ulps)
+  {
+    t.over++;
+    if (verbose && b != BACKEND_FLOAT && b != BACKEND_DD)
+      printf ("%s off by %g ulps: %s at (%.17g, %.17g): %.17g vs %.17g\n",
+              backend_names[b], d, expr.c_str(), x, y, ref, val);
+  }
+  if (d > t.worst)
+  {
+    t.worst = d;
+    t.worst_expr = expr;
+    t.worst_x = x;
+    t.worst_y = y;
+    t.worst_ref = ref;
+    t.worst_val = val;
+  }
+}
+
+// a point: mostly ordinary, sometimes large, sometimes tiny
+static double
+random_coord (void)
+{
+  switch (random_int (10))
+  {
+    case 0:  return random_real (-1000.0, 1000.0);
+    case 1:  return random_real (-1e-3, 1e-3);
+    case 2:  return (double) (random_int (21) - 10);  // on the axes, poles
+    default: return random_real (-10.0, 10.0);
+  }
+}
+
+// the central difference of f along var at x_y, with step h
+static double
+central_diff (const Function& f, const double *x_y, var_enum var, double h)
+{
+  double p[ NUM_VALUES ] = { x_y[0], x_y[1] };
+  double m[ NUM_VALUES ] = { x_y[0], x_y[1] };
+  p[ var ] += h;
+  m[ var ] -= h;
+  return (f (p) - f (m)) / (2.0 * h);
+}
+
+struct DerivTally
+{
+  long checked, skipped, wrong;
+};
+
+// true if everything evaluating prog at x_y comes to is finite, not so
+// large that adding anything ordinary to it would be lost, and no sum or
+// difference cancels away nearly all of its digits, as 1 - coth (x)^2
+// does once coth (x) is within a few ulps of 1
+static bool
+well_scaled (const Program& prog, const double *x_y)
+{
+  vector< double > regs (prog.get_num_nodes());
+  for (int deps = 0; deps < NUM_DEPS; deps++)
+    prog.eval_stage (deps, x_y, &regs[0]);
+
+  for (int k = 0; k < regs.size(); k++)
+  {
+    if (!(fabs (regs[k]) < 1e12))
+      return false;
+
+    const Program::Node& n = prog.get_node (k);
+    if (n.v.type == Variant::OP &&
+        (n.v.op == op_plus || n.v.op == op_minus) && n.arg2 >= 0)
+    {
+      double size = max (fabs (regs[ n.arg1 ]), fabs (regs[ n.arg2 ]));
+      if (fabs (regs[k]) < 1e-9 * size)
+        return false;
+    }
+  }
+  return true;
+}
+
+// the central difference of f at x_y with step h, if it settles down
+// at h, h/2 and h/4, so f is smooth at that scale, and f is small enough
+// next to the step that rounding doesn't decide
+static bool
+settled_diff (const Function& f, double *x_y, var_enum var, double h,
+              double d, double& diff, double& scale)
+{
+  double fd1 = central_diff (f, x_y, var, h);
+  double fd2 = central_diff (f, x_y, var, h / 2);
+  double fd4 = central_diff (f, x_y, var, h / 4);
+
+  scale = max (max (1.0, fabs (d)), max (fabs (fd1), fabs (fd2)));
+  diff = fd4;
+
+  // f flat to the last bit while df is not: rounded onto a plateau,
+  // as acoth (coth (x)) is once coth (x) is 1
+  if (fd1 == 0 && fd2 == 0 && fd4 == 0 && d != 0)
+    return false;
+
+  double noise = DBL_EPSILON * fabs (f (x_y)) / (h / 4);
+  return isfinite (fd1) && isfinite (fd2) && isfinite (fd4) &&
+         fabs (fd1 - fd2) <= 1e-4 * scale &&
+         fabs (fd2 - fd4) <= 1e-4 * scale &&
+         scale <= 1e6 && noise < 1e-6 * scale;
+}
+
+enum verdict_enum { SKIPPED, RIGHT, WRONG };
+
+// df, the derivative along var, against central differences of f. Not
+// where anything on the way to f or df overflows, or is undefined and
+// then multiplied by 0, or is huge: rounding or the 0 * NaN = 0 rule
+// decide there. A mismatch is tried again with a much smaller step, in
+// case f oscillated faster than the first one could follow.
+static verdict_enum
+judge_deriv (const Function& f, const Function& df,
+             const Program& f_prog, const Program& df_prog,
+             var_enum var, double *x_y, double& d, double& diff)
+{
+  d = df (x_y);
+  double h = 1e-5 * max (1.0, fabs (x_y[ var ]));
+  double scale;
+
+  if (!well_scaled (f_prog, x_y) || !well_scaled (df_prog, x_y) ||
+      !settled_diff (f, x_y, var, h, d, diff, scale))
+    return SKIPPED;
+
+  if (fabs (d - diff) > 1e-3 * scale &&
+      !settled_diff (f, x_y, var, h / 1000, d, diff, scale))
+    return SKIPPED;
+
+  return (fabs (d - diff) > 1e-3 * scale) ? WRONG : RIGHT;
+}
+
+// a wrong rule is wrong all around the point; a mismatch that goes away
+// further on was rounding, e.g. cos (x) or cosh (x) next to 1
+static void
+check_deriv (DerivTally& t, const Function& f, const Function& df,
+             const Program& f_prog, const Program& df_prog,
+             var_enum var, const string& expr, const double *x_y)
+{
+  double p[ NUM_VALUES ] = { x_y[0], x_y[1] };
+  double d, diff;
+
+  verdict_enum v = judge_deriv (f, df, f_prog, df_prog, var, p, d, diff);
+  for (double step = 1e-3; v == WRONG && step < 1; step *= 10)
+  {
+    double q[ NUM_VALUES ] = { p[0] + step * max (1.0, fabs (p[0])),
+                               p[1] + step * max (1.0, fabs (p[1])) };
+    double d2, diff2;
+    if (judge_deriv (f, df, f_prog, df_prog, var, q, d2, diff2) != WRONG)
+      v = SKIPPED;
+  }
+
+  if (v == SKIPPED)
+  {
+    t.skipped++;
+    return;
+  }
+
+  t.checked++;
+  if (v == WRONG)
+  {
+    t.wrong++;
+    if (verbose || t.wrong <= 5)
+      printf ("deriv d/d%s wrong: %s at (%.17g, %.17g): %.17g, "
+              "differences give %.17g\n",
+              var_names[ var ], expr.c_str(), p[0], p[1], d, diff);
+  }
+}
+
+static void
+usage (void)
+{
+  fprintf (stderr,
+           "usage: eval_fuzz [-n expressions] [-p points] [-s seed] "
+           "[-d depth]\n"
+           "                 [-u max_ulps] [-v]\n");
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  int num_exprs = 1000, num_points = 64, depth = 5;
+  double max_ulps = 0;
+
+  int opt;
+  while ((opt = getopt (argc, argv, "n:p:s:d:u:v")) != -1)
+  {
+    switch (opt)
+    {
+      case 'n': num_exprs  = atoi (optarg); break;
+      case 'p': num_points = atoi (optarg); break;
+      case 's': seed       = strtoull (optarg, NULL, 10); break;
+      case 'd': depth      = atoi (optarg); break;
+      case 'u': max_ulps   = atof (optarg); break;
+      case 'v': verbose    = true; break;
+      default:  usage();
+    }
+  }
+  if (optind != argc || num_exprs <= 0 || num_points <= 0 || depth < 0)
+    usage();
+
+  unsigned long long first_seed = seed;
+
+  const int B = Program::BATCH;
+
+  Tally tally[ NUM_BACKENDS ];
+  for (int b = 0; b < NUM_BACKENDS; b++)
+  {
+    tally[b].compared = tally[b].exact = tally[b].over = 0;
+    tally[b].nan_mismatches = tally[b].inf_mismatches = 0;
+    tally[b].rounded = 0;
+    tally[b].worst = 0;
+  }
+  DerivTally deriv_tally = { 0, 0, 0 };
+  long interval_checks = 0, interval_misses = 0, parse_failures = 0;
+
+  for (int e = 0; e < num_exprs; e++)
+  {
+    string expr = random_expr (depth);
+
+    Function f, df_dx, df_dy;
+    try
+    {
+      f = Function (expr);
+      df_dx = f.differentiate (var_x);
+      df_dy = f.differentiate (var_y);
+    }
+    catch (...)
+    {
+      parse_failures++;
+      if (verbose)
+        printf ("does not parse: %s\n", expr.c_str());
+      continue;
+    }
+
+    Program prog (vector< Function > (1, f));
+    Program dx_prog (vector< Function > (1, df_dx));
+    Program dy_prog (vector< Function > (1, df_dy));
+    int out = prog.get_output_node (0);
+    int num_nodes = prog.get_num_nodes();
+
+    vector< double > regs (num_nodes), out_vals (1);
+    vector< DoubleDouble > regs_dd (num_nodes);
+    vector< Interval > regs_i (num_nodes);
+
+    // the points, whole batches of them
+    int n = (num_points + B - 1) / B * B;
+    vector< double > xs (n), ys (n), ref (n);
+    for (int i = 0; i < n; i++)
+    {
+      xs[i] = random_coord();
+      ys[i] = random_coord();
+      double x_y[ NUM_VALUES ] = { xs[i], ys[i] };
+      ref[i] = f (x_y);
+    }
+
+    // one point at a time
+    for (int i = 0; i < n; i++)
+    {
+      double x_y[2] = { xs[i], ys[i] };
+
+      prog (x_y, &regs[0], &out_vals[0]);
+      compare (tally[ BACKEND_PROGRAM ], BACKEND_PROGRAM, ref[i],
+               out_vals[0], max_ulps, expr, xs[i], ys[i]);
+
+      fill (regs.begin(), regs.end(), 0.0);
+      for (int deps = 0; deps < NUM_DEPS; deps++)
+        prog.eval_stage (deps, x_y, &regs[0]);
+      compare (tally[ BACKEND_STAGES ], BACKEND_STAGES, ref[i],
+               regs[ out ], max_ulps, expr, xs[i], ys[i]);
+
+      // against the double stages just above, node by node
+      DoubleDouble x_y_dd[2] = { xs[i], ys[i] };
+      for (int deps = 0; deps < NUM_DEPS; deps++)
+        prog.eval_stage (deps, x_y_dd, &regs_dd[0]);
+      double val_dd = regs_dd[ out ].to_double();
+      compare (tally[ BACKEND_DD ], BACKEND_DD, ref[i], val_dd, max_ulps,
+               expr, xs[i], ys[i],
+               value_class (ref[i]) != value_class (val_dd) &&
+                 rounding_explains (prog, &regs[0], &regs_dd[0], 1));
+
+      // the bounds leave out what is undefined, and say nothing past
+      // an overflow, so only points where everything on the way to the
+      // value is finite are held to them
+      bool finite = true;
+      for (int k = 0; k < num_nodes; k++)
+        finite = finite && isfinite (regs[k]);
+
+      // at the point itself, and over a box around it
+      for (int box = 0; finite && box < 2; box++)
+      {
+        double r = box ? random_real (0.0, 1.0) : 0.0;
+        Interval x_y_i[2] = { Interval (xs[i] - r, xs[i] + r),
+                              Interval (ys[i] - r, ys[i] + r) };
+        for (int deps = 0; deps < NUM_DEPS; deps++)
+          prog.eval_stage (deps, x_y_i, &regs_i[0]);
+
+        interval_checks++;
+        if (!regs_i[ out ].contains (ref[i]))
+        {
+          interval_misses++;
+          printf ("interval [%.17g, %.17g] misses %.17g: %s at "
+                  "(%.17g, %.17g) +- %g\n", regs_i[ out ].lo,
+                  regs_i[ out ].hi, ref[i], expr.c_str(), xs[i], ys[i], r);
+        }
+      }
+
+      check_deriv (deriv_tally, f, df_dx, prog, dx_prog, var_x, expr, x_y);
+      check_deriv (deriv_tally, f, df_dy, prog, dy_prog, var_y, expr, x_y);
+    }
+
+    // a batch at a time
+    vector< double > batch_regs (num_nodes * B);
+    vector< float > batch_regs_f (num_nodes * B);
+    vector< float > xs_f (xs.begin(), xs.end()), ys_f (ys.begin(), ys.end());
+    for (int i = 0; i < n; i += B)
+    {
+      const double *vars[ NUM_VARS ] = { &xs[i], &ys[i] };
+      prog.eval_batch (0, num_nodes, vars, &batch_regs[0]);
+
+      const float *vars_f[ NUM_VARS ] = { &xs_f[i], &ys_f[i] };
+      prog.eval_batch (0, num_nodes, vars_f, &batch_regs_f[0]);
+
+      for (int l = 0; l < B; l++)
+      {
+        compare (tally[ BACKEND_BATCH ], BACKEND_BATCH, ref[i + l],
+                 batch_regs[ out * B + l ], max_ulps, expr,
+                 xs[i + l], ys[i + l]);
+        float val_f = batch_regs_f[ out * B + l ];
+        compare (tally[ BACKEND_FLOAT ], BACKEND_FLOAT, ref[i + l], val_f,
+                 max_ulps, expr, xs[i + l], ys[i + l],
+                 value_class (ref[i + l]) != value_class (val_f) &&
+                   rounding_explains (prog, &batch_regs[l],
+                                      &batch_regs_f[l], B));
+      }
+    }
+  }
+
+  printf ("%d expressions (%ld did not parse), %d points each, seed %llu\n\n",
+          num_exprs, parse_failures, num_points, first_seed);
+  printf ("%-8s %10s %8s %10s %8s %8s %8s %12s\n", "backend", "compared",
+          "exact", "> ulps", "NaN", "Inf", "rounded", "worst ulps");
+  for (int b = 0; b < NUM_BACKENDS; b++)
+  {
+    Tally& t = tally[b];
+    printf ("%-8s %10ld %7.2f%% %10ld %8ld %8ld %8ld %12.4g\n",
+            backend_names[b],
+            t.compared, t.compared ? 100.0 * t.exact / t.compared : 0.0,
+            t.over, t.nan_mismatches, t.inf_mismatches, t.rounded, t.worst);
+  }
+
+  printf ("\nworst cases:\n");
+  for (int b = 0; b < NUM_BACKENDS; b++)
+    if (tally[b].worst > 0)
+      printf ("  %-8s %s at (%.17g, %.17g): %.17g vs %.17g\n",
+              backend_names[b], tally[b].worst_expr.c_str(),
+              tally[b].worst_x, tally[b].worst_y, tally[b].worst_ref,
+              tally[b].worst_val);
+
+  printf ("\nintervals: %ld checked, %ld missed\n",
+          interval_checks, interval_misses);
+  printf ("derivatives: %ld checked, %ld skipped as ill-conditioned, %ld wrong\n",
+          deriv_tally.checked, deriv_tally.skipped, deriv_tally.wrong);
+
+  bool failed = interval_misses > 0 || deriv_tally.wrong > 0;
+  for (int b = 0; b < NUM_BACKENDS; b++)
+    failed = failed || tally[b].nan_mismatches > 0 ||
+             tally[b].inf_mismatches > 0;
+  for (int b = BACKEND_PROGRAM; b <= BACKEND_BATCH; b++)
+    failed = failed || tally[b].over > 0;
+
+  printf ("\n%s\n", failed ? "FAILED" : "ok");
+  return failed ? 1 : 0;
+}
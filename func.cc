@@ -4,6 +4,8 @@
 #include <math.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <time.h>
+#include <algorithm>
 #include <vector>
 #include <string>
 
@@ -68,6 +70,61 @@ static double (*op_funcs[])(double arg) = {
   NULL             // op_differentiate
 };
 
+// the same in single precision
+static float cscf   (float d) { return 1.0f / sinf (d); }
+static float secf   (float d) { return 1.0f / cosf (d); }
+static float cotf   (float d) { return 1.0f / tanf (d); }
+static float cschf  (float d) { return 1.0f / sinhf (d); }
+static float sechf  (float d) { return 1.0f / coshf (d); }
+static float cothf  (float d) { return 1.0f / tanhf (d); }
+static float acscf  (float d) { return asinf (1.0f / d); }
+static float asecf  (float d) { return acosf (1.0f / d); }
+static float acotf  (float d) { return atanf (1.0f / d); }
+static float acschf (float d)
+                    { return logf ((1.0f / d) + sqrtf (1.0f + d*d) / fabsf (d)); }
+static float asechf (float d) { return logf ((1.0f + sqrtf (1.0f - d*d)) / d); }
+static float acothf (float d) { return 0.5f * logf ((d + 1.0f) / (d - 1.0f)); }
+
+static float (*op_funcs_f[])(float arg) = {
+  sinf,            // op_sin
+  cosf,            // op_cos
+  tanf,            // op_tan
+  cscf,            // op_csc
+  secf,            // op_sec
+  cotf,            // op_cot
+  asinf,           // op_asin
+  acosf,           // op_acos
+  atanf,           // op_atan
+  acscf,           // op_acsc
+  asecf,           // op_asec
+  acotf,           // op_acot
+  sinhf,           // op_sinh
+  coshf,           // op_cosh
+  tanhf,           // op_tanh
+  cschf,           // op_csch
+  sechf,           // op_sech
+  cothf,           // op_coth
+  asinhf,          // op_asinh
+  acoshf,          // op_acosh
+  atanhf,          // op_atanh
+  acschf,          // op_acsch
+  asechf,          // op_asech
+  acothf,          // op_acoth
+  log10f,          // op_log
+  logf,            // op_ln
+  expf,            // op_exp
+  sqrtf,           // op_sqrt
+  fabsf,           // op_abs
+  NULL,            // op_plus
+  NULL,            // op_minus
+  NULL,            // op_mult
+  NULL,            // op_div
+  NULL,            // op_pow
+  NULL,            // op_openparen
+  NULL,            // op_closeparen
+  NULL             // op_differentiate
+};
+
 static int
 calc_max_eval_stack_size (const vector< Variant >& RPN_stack)
 {
@@ -87,16 +144,21 @@ calc_max_eval_stack_size (const vector< Variant >& RPN_stack)
 
 namespace Math {
 
-Function::Function (string expr) throw (ArgumentException, SyntaxException)
+Function::Function (string expr, param_set params)
+  throw (ArgumentException, SyntaxException)
 {
   // in case there's an exception, so the destructor still works
   eval_stack = NULL;
 
   // create the RPN representation of the function
-  RPN_stack = parse_into_RPN (expr);
+  RPN_stack = parse_into_RPN (expr, &spans, params);
+  source = expr;
 
   // allocate the evaluation stack
   eval_stack = new double [calc_max_eval_stack_size (RPN_stack)];
+#ifdef FUNC_PROFILE
+  reset_profile();
+#endif
 }
 
 Function
@@ -105,6 +167,9 @@ Function::FromRPN (const vector< Variant >& RPN_stack)
   Function f;
   f.RPN_stack = RPN_stack;
   f.eval_stack = new double [calc_max_eval_stack_size (RPN_stack)];
+#ifdef FUNC_PROFILE
+  f.reset_profile();
+#endif
   return f;
 }
 
@@ -118,81 +183,192 @@ Function::operator= (const Function& other)
 
   RPN_stack = other.RPN_stack;
   eval_stack = new double [calc_max_eval_stack_size (RPN_stack)];
+  source = other.source;
+  spans = other.spans;
+#ifdef FUNC_PROFILE
+  reset_profile();
+#endif
 
   return *this;
 }
 
+// one element of the RPN: pushes a value, or replaces the arguments on
+// top of the stack with the result of an operation
+static inline void
+eval_element (const Variant& cur, const double *var_values,
+              double *eval_stack, int& eval_stack_size)
+{
+  if (cur.type == Variant::CONSTANT)
+    eval_stack[ eval_stack_size++ ] = cur.val;
+  else if (cur.type == Variant::VARIABLE)
+    eval_stack[ eval_stack_size++ ] = var_values[ (int)cur.var ];
+  else
+  {
+    double ans;
+    
+    switch (cur.op)
+    {
+      case op_plus:
+        ans = eval_stack [eval_stack_size - 2] +
+              eval_stack [eval_stack_size - 1];
+        eval_stack_size--;
+        break;
+
+      case op_minus:
+        ans = eval_stack [eval_stack_size - 2] -
+              eval_stack [eval_stack_size - 1];
+        eval_stack_size--;
+        break;
+
+      case op_div:
+        { // we rely on 0 / NaN == 0
+          double arg1 = eval_stack [eval_stack_size - 2];
+          
+          // TODO: only do this if arg1 is a constant
+          ans = (arg1 == 0.0) ? 0.0 : arg1 / eval_stack [eval_stack_size - 1];
+          eval_stack_size--;
+        }
+        break;
+
+      case op_mult:
+        { // we rely on 0 * NaN == 0
+          double arg1 = eval_stack [eval_stack_size - 2];
+          double arg2 = eval_stack [eval_stack_size - 1];
+          
+          // TODO: only do this if the zero is a constant
+          ans =  (arg1 == 0.0 || arg2 == 0.0) ? 0.0 : arg1 * arg2;
+          eval_stack_size--;
+        }
+        break;
+      
+      case op_pow:
+        ans = pow (eval_stack [eval_stack_size - 2],
+                   eval_stack [eval_stack_size - 1]);
+        eval_stack_size--;
+        break;
+      
+      default:
+        ans = op_funcs[ (int)cur.op ] (eval_stack[ eval_stack_size - 1 ]);
+        break;
+    }
+
+    eval_stack[ eval_stack_size - 1 ] = ans;
+  }
+}
+
 double
 Function::operator() (double *var_values) const
 {
+#ifdef FUNC_PROFILE
+  if (evals++ % PROFILE_PERIOD == 0)
+    return eval_profiled (var_values);
+#endif
+
   int eval_stack_size = 0;
   
   for (int i = 0; i < RPN_stack.size(); i++)
   {
-    Variant cur = RPN_stack[i];
-    
-    if (cur.type == Variant::CONSTANT)
-      eval_stack[ eval_stack_size++ ] = cur.val;
-    else if (cur.type == Variant::VARIABLE)
-      eval_stack[ eval_stack_size++ ] = var_values[ (int)cur.var ];
-    else
+#ifdef FUNC_PROFILE
+    profile[i].count++;
+#endif
+    eval_element (RPN_stack[i], var_values, eval_stack, eval_stack_size);
+  }
+
+  assert (eval_stack_size == 1);
+  return eval_stack[0];
+}
+
+#ifdef FUNC_PROFILE
+// a clock as fine as there is: the time stamp counter on x86
+static inline double
+read_cycles (void)
+{
+#if defined (__i386__) || defined (__x86_64__)
+  unsigned int lo, hi;
+  __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((unsigned long long) hi << 32 | lo);
+#else
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+#endif
+}
+
+// what reading the clock twice costs by itself, taken off every sample
+static double
+clock_overhead (void)
+{
+  static double overhead = -1.0;
+  if (overhead < 0.0)
+  {
+    overhead = HUGE_VAL;
+    for (int i = 0; i < 1000; i++)
     {
-      double ans;
-      
-      switch (cur.op)
-      {
-	case op_plus:
-	  ans = eval_stack [eval_stack_size - 2] +
-	        eval_stack [eval_stack_size - 1];
-	  eval_stack_size--;
-	  break;
-
-	case op_minus:
-	  ans = eval_stack [eval_stack_size - 2] -
-	        eval_stack [eval_stack_size - 1];
-	  eval_stack_size--;
-	  break;
-
-        case op_div:
-	  { // we rely on 0 / NaN == 0
-	    double arg1 = eval_stack [eval_stack_size - 2];
-	    
-	    // TODO: only do this if arg1 is a constant
-	    ans = (arg1 == 0.0) ? 0.0 : arg1 / eval_stack [eval_stack_size - 1];
-	    eval_stack_size--;
-	  }
-	  break;
-
-        case op_mult:
-	  { // we rely on 0 * NaN == 0
-	    double arg1 = eval_stack [eval_stack_size - 2];
-	    double arg2 = eval_stack [eval_stack_size - 1];
-	    
-	    // TODO: only do this if the zero is a constant
-	    ans =  (arg1 == 0.0 || arg2 == 0.0) ? 0.0 : arg1 * arg2;
-	    eval_stack_size--;
-	  }
-	  break;
-	
-	case op_pow:
-	  ans = pow (eval_stack [eval_stack_size - 2],
-	             eval_stack [eval_stack_size - 1]);
-	  eval_stack_size--;
-	  break;
-	
-	default:
-	  ans = op_funcs[ (int)cur.op ] (eval_stack[ eval_stack_size - 1 ]);
-	  break;
-      }
-
-      eval_stack[ eval_stack_size - 1 ] = ans;
+      double start = read_cycles();
+      overhead = min (overhead, read_cycles() - start);
     }
   }
+  return overhead;
+}
+
+double
+Function::eval_profiled (double *var_values) const
+{
+  double overhead = clock_overhead();
+  int eval_stack_size = 0;
+
+  for (int i = 0; i < RPN_stack.size(); i++)
+  {
+    double start = read_cycles();
+    eval_element (RPN_stack[i], var_values, eval_stack, eval_stack_size);
+    double spent = read_cycles() - start - overhead;
+
+    profile[i].count++;
+    profile[i].samples++;
+    profile[i].cycles += max (spent, 0.0);
+  }
 
   assert (eval_stack_size == 1);
   return eval_stack[0];
 }
 
+void
+Function::reset_profile (void) const
+{
+  ProfileEntry zero = { 0, 0, 0.0 };
+  profile.assign (RPN_stack.size(), zero);
+  evals = 0;
+}
+#endif
+
+double
+eval_op (ops_enum op, double arg1, double arg2)
+{
+  switch (op)
+  {
+    case op_plus:  return arg1 + arg2;
+    case op_minus: return arg1 - arg2;
+    case op_div:   return (arg1 == 0.0) ? 0.0 : arg1 / arg2;
+    case op_mult:  return (arg1 == 0.0 || arg2 == 0.0) ? 0.0 : arg1 * arg2;
+    case op_pow:   return pow (arg1, arg2);
+    default:       break;
+  }
+
+  return op_funcs[ (int)op ] (arg1);
+}
+
+unary_func
+get_unary_func (ops_enum op)
+{
+  return op_funcs[ (int)op ];
+}
+
+unary_funcf
+get_unary_funcf (ops_enum op)
+{
+  return op_funcs_f[ (int)op ];
+}
+
 Function
 Function::differentiate (var_enum var) const
 {
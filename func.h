@@ -6,13 +6,31 @@
 
 namespace Math
 {
+  // x and y, then the parameters: every other single letter, a to w and
+  // z, written like a variable but bound to a value when evaluating, so
+  // that "y = a*sin(kx)" is parsed and compiled once for every a and k.
+  // Parameter p is var_enum (NUM_VARS + p). A letter is only taken for a
+  // parameter where whoever parses says it is one (see param_set), and
+  // is a syntax error elsewhere, so that a typo such as "sinx" isn't
+  // quietly read as s*i*n*x. (Function names are matched first: with a
+  // declared, "a sin(x)" is still asin(x).)
   enum var_enum
   {
     var_x,
     var_y,
-    NUM_VARS
+    NUM_VARS,
+    NUM_VALUES = NUM_VARS + 24
   };
 
+  const int NUM_PARAMS = NUM_VALUES - NUM_VARS;
+
+  inline bool is_param (var_enum v) { return v >= NUM_VARS; }
+
+  // the parameters an expression may use, a bit for each
+  typedef unsigned long param_set;
+  const param_set NO_PARAMS = 0;
+  inline param_set param_bit (var_enum v) { return 1UL << (v - NUM_VARS); }
+
   enum ops_enum
   {
     op_sin,
@@ -94,6 +112,39 @@ namespace Math
     }
   };
 
+  // evaluates a single operation the same way Function does; arg2 is
+  // ignored by the unary (non-infix) operations
+  double eval_op (ops_enum op, double arg1, double arg2 = 0.0);
+
+  // the libm-style function computing a unary operation, in double and
+  // in single precision (NULL for the infix operations)
+  typedef double (*unary_func)  (double);
+  typedef float  (*unary_funcf) (float);
+  unary_func  get_unary_func  (ops_enum op);
+  unary_funcf get_unary_funcf (ops_enum op);
+
+  // where an RPN element came from: the characters [begin, end) of the
+  // expression, after the parser's rewriting (no spaces, "0" before a
+  // unary minus). Elements without text of their own, like the * of
+  // "2x", have begin == end.
+  struct Span
+  {
+    int begin, end;
+  };
+
+#ifdef FUNC_PROFILE
+  // what evaluating one RPN element has cost. Every execution is
+  // counted, but only one evaluation in PROFILE_PERIOD is timed, so
+  // the cycles are of 'samples' executions.
+  struct ProfileEntry
+  {
+    long count, samples;
+    double cycles;
+  };
+
+  #define PROFILE_PERIOD 16
+#endif
+
   class SyntaxException
   {
   public:
@@ -117,10 +168,28 @@ namespace Math
   {
     std::vector< Variant > RPN_stack;
     double *eval_stack;
+
+    std::string source;         // the parsed text, empty if built from RPN
+    std::vector< Span > spans;  // of each RPN element in source
+
+#ifdef FUNC_PROFILE
+    // built with -DFUNC_PROFILE, every evaluation is profiled; without
+    // it, none of this exists
+    mutable std::vector< ProfileEntry > profile;
+    mutable long evals;
+    double eval_profiled (double *var_values) const;
+#endif
    
   public:
-    Function (void) { eval_stack = NULL; }
-    Function (std::string expr) throw (SyntaxException, ArgumentException);
+    Function (void)
+    {
+      eval_stack = NULL;
+#ifdef FUNC_PROFILE
+      evals = 0;
+#endif
+    }
+    Function (std::string expr, param_set params = NO_PARAMS)
+      throw (SyntaxException, ArgumentException);
     Function (const Function& other){ eval_stack = NULL; *this = other; }
     
     ~Function (void)
@@ -133,11 +202,23 @@ namespace Math
     Function& operator= (const Function& other);
     
     Function differentiate (var_enum var) const;
+
+    // var_values[v] is the value of x, y or parameter v; it only needs
+    // to be as long as the last one the function uses
     double operator() (double *var_values) const;
 
-    std::vector< Variant > get_rpn_stack (void)
+    std::vector< Variant > get_rpn_stack (void) const
     { return RPN_stack; }
 
+    const std::string& get_source (void) const { return source; }
+    const std::vector< Span >& get_spans (void) const { return spans; }
+
+#ifdef FUNC_PROFILE
+    const std::vector< ProfileEntry >& get_profile (void) const
+    { return profile; }
+    void reset_profile (void) const;
+#endif
+
     // don't use this
     static Function FromRPN (const std::vector< Variant >& RPN_stack);
   };
@@ -0,0 +1,552 @@
+#include "func_file.h"
+#include "parse.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <map>
+#include <algorithm>
+
+using namespace std;
+using namespace Math;
+
+// The file, every part starting 8-byte aligned:
+//
+//   FileHeader
+//   the variable table: num_vars names, VAR_NAME_SIZE bytes each
+//   num_entries offsets of the records, sorted by their source
+//   the records: a RecordHeader, the source, then a block for each F
+//     (each followed by blocks for dF/dx and dF/dy, if REC_DERIVS), then
+//     one for each Y
+//
+// and a block is a BlockHeader, its constant pool as doubles, then its
+// RPN as 16-bit elements: the top two bits say what the rest is, the
+// index of an operation, a constant of the pool or a variable of the
+// table. Everything is in the writer's byte order.
+
+#define FILE_MAGIC     "GRFN"
+#define BYTE_ORDER_TAG 0x01020304
+#define VAR_NAME_SIZE  8
+
+#define ELEM_OP        0
+#define ELEM_CONST     1
+#define ELEM_VAR       2
+#define ELEM_SHIFT     14
+#define ELEM_MAX_INDEX ((1 << ELEM_SHIFT) - 1)
+
+#define REC_DERIVS     1
+
+namespace {
+
+struct FileHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t num_vars;
+  uint32_t num_entries;
+  uint32_t reserved;
+};
+
+struct RecordHeader
+{
+  uint32_t source_len;
+  uint32_t num_F, num_Y;
+  uint32_t flags;
+};
+
+struct BlockHeader
+{
+  uint32_t num_code;
+  uint32_t num_consts;
+};
+
+size_t
+align8 (size_t n)
+{
+  return (n + 7) & ~(size_t) 7;
+}
+
+void
+put (vector< unsigned char >& out, const void *data, size_t size)
+{
+  const unsigned char *p = (const unsigned char*) data;
+  out.insert (out.end(), p, p + size);
+}
+
+void
+pad (vector< unsigned char >& out)
+{
+  out.resize (align8 (out.size()), 0);
+}
+
+// the order of the records, and of find()'s search
+int
+compare_source (const char *a, size_t a_len, const char *b, size_t b_len)
+{
+  int c = memcmp (a, b, min (a_len, b_len));
+  if (c != 0)
+    return c;
+  return (a_len < b_len) ? -1 : (a_len > b_len);
+}
+
+struct SourceLess
+{
+  const vector< FunctionEntry > *entries;
+
+  bool operator() (int i, int j) const
+  {
+    const string& a = (*entries)[i].source;
+    const string& b = (*entries)[j].source;
+    return compare_source (a.data(), a.size(), b.data(), b.size()) < 0;
+  }
+};
+
+// f as a block; false if it doesn't fit the format
+bool
+put_block (vector< unsigned char >& out, const Function& f)
+{
+  vector< Variant > RPN = f.get_rpn_stack();
+
+  // the same constant, bit for bit, is stored once
+  vector< double > consts;
+  map< uint64_t, int > const_map;
+  vector< uint16_t > code;
+  for (int i = 0; i < RPN.size(); i++)
+  {
+    const Variant& v = RPN[i];
+    int kind, index;
+    if (v.type == Variant::CONSTANT)
+    {
+      uint64_t bits;
+      memcpy (&bits, &v.val, sizeof (bits));
+      map< uint64_t, int >::iterator it = const_map.find (bits);
+      if (it == const_map.end())
+      {
+        it = const_map.insert (make_pair (bits, (int) consts.size())).first;
+        consts.push_back (v.val);
+      }
+      kind = ELEM_CONST;
+      index = it->second;
+    }
+    else if (v.type == Variant::VARIABLE)
+    {
+      kind = ELEM_VAR;
+      index = v.var;          // the table is var_names, in order
+    }
+    else
+    {
+      kind = ELEM_OP;
+      index = v.op;
+    }
+
+    if (index > ELEM_MAX_INDEX)
+      return false;
+    code.push_back ((kind << ELEM_SHIFT) | index);
+  }
+
+  BlockHeader h;
+  h.num_code = code.size();
+  h.num_consts = consts.size();
+  put (out, &h, sizeof (h));
+  if (!consts.empty())
+    put (out, &consts[0], consts.size() * sizeof (double));
+  if (!code.empty())
+    put (out, &code[0], code.size() * sizeof (uint16_t));
+  pad (out);
+  return true;
+}
+
+// e's record; false if a function doesn't fit the format
+bool
+put_record (vector< unsigned char >& out, const FunctionEntry& e,
+            bool derivs)
+{
+  RecordHeader h;
+  h.source_len = e.source.size();
+  h.num_F = e.F.size();
+  h.num_Y = e.Y.size();
+  h.flags = derivs ? REC_DERIVS : 0;
+  put (out, &h, sizeof (h));
+  put (out, e.source.data(), e.source.size());
+  pad (out);
+
+  bool have_dF = (e.dF.size() == 2 * e.F.size());
+  for (int i = 0; i < e.F.size(); i++)
+  {
+    if (!put_block (out, e.F[i]))
+      return false;
+    if (!derivs)
+      continue;
+
+    if (!put_block (out, have_dF ? e.dF[2*i]
+                                 : e.F[i].differentiate (var_x)) ||
+        !put_block (out, have_dF ? e.dF[2*i + 1]
+                                 : e.F[i].differentiate (var_y)))
+      return false;
+  }
+  for (int i = 0; i < e.Y.size(); i++)
+    if (!put_block (out, e.Y[i]))
+      return false;
+
+  return true;
+}
+
+} // namespace
+
+bool
+write_function_file (const char *path, const vector< FunctionEntry >& entries,
+                     bool derivs)
+{
+  vector< int > order;
+  for (int i = 0; i < entries.size(); i++)
+    order.push_back (i);
+  SourceLess less = { &entries };
+  stable_sort (order.begin(), order.end(), less);
+
+  // only the first of entries with the same source could ever be found
+  vector< int > unique_order;
+  for (int k = 0; k < order.size(); k++)
+    if (k == 0 || less (order[k-1], order[k]))
+      unique_order.push_back (order[k]);
+
+  vector< unsigned char > records;
+  vector< uint32_t > offsets;
+  size_t records_begin = align8 (sizeof (FileHeader) +
+                                 NUM_VALUES * VAR_NAME_SIZE +
+                                 unique_order.size() * sizeof (uint32_t));
+  for (int k = 0; k < unique_order.size(); k++)
+  {
+    offsets.push_back (records_begin + records.size());
+    if (!put_record (records, entries[ unique_order[k] ], derivs))
+    {
+      errno = EFBIG;
+      return false;
+    }
+  }
+  if (records_begin + records.size() > 0xffffffffUL)
+  {
+    errno = EFBIG;
+    return false;
+  }
+
+  vector< unsigned char > out;
+  FileHeader h;
+  memcpy (h.magic, FILE_MAGIC, sizeof (h.magic));
+  h.version = FUNC_FILE_VERSION;
+  h.byte_order = BYTE_ORDER_TAG;
+  h.num_vars = NUM_VALUES;
+  h.num_entries = offsets.size();
+  h.reserved = 0;
+  put (out, &h, sizeof (h));
+
+  for (int v = 0; v < NUM_VALUES; v++)
+  {
+    char name[ VAR_NAME_SIZE ];
+    memset (name, 0, sizeof (name));
+    strncpy (name, var_names[v], sizeof (name) - 1);
+    put (out, name, sizeof (name));
+  }
+  if (!offsets.empty())
+    put (out, &offsets[0], offsets.size() * sizeof (uint32_t));
+  pad (out);
+
+  FILE *f = fopen (path, "wb");
+  if (!f)
+    return false;
+  bool ok = fwrite (&out[0], 1, out.size(), f) == out.size() &&
+            (records.empty() ||
+             fwrite (&records[0], 1, records.size(), f) == records.size());
+  int saved_errno = errno;
+  if (fclose (f) != 0)
+    ok = false;
+  else
+    errno = saved_errno;
+  return ok;
+}
+
+FunctionFile::FunctionFile (void)
+{
+  data = NULL;
+  size = 0;
+  num_entries = 0;
+}
+
+FunctionFile::~FunctionFile (void)
+{
+  close();
+}
+
+bool
+FunctionFile::open (const char *path)
+{
+  close();
+
+  int fd = ::open (path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat (fd, &st) != 0)
+  {
+    error = strerror (errno);
+    if (fd >= 0)
+      ::close (fd);
+    return false;
+  }
+
+  size = st.st_size;
+  void *map = (size > 0) ? mmap (NULL, size, PROT_READ, MAP_SHARED, fd, 0)
+                         : MAP_FAILED;
+  ::close (fd);   // the mapping keeps the file
+  if (map == MAP_FAILED)
+  {
+    error = (size > 0) ? strerror (errno) : "empty file";
+    size = 0;
+    return false;
+  }
+  data = (const unsigned char*) map;
+
+  const FileHeader *h = (const FileHeader*) data;
+  if (size < sizeof (FileHeader) ||
+      memcmp (h->magic, FILE_MAGIC, sizeof (h->magic)) != 0)
+    error = "not a function file";
+  else if (h->byte_order != BYTE_ORDER_TAG)
+    error = "written on a machine of another byte order";
+  else if (h->version != FUNC_FILE_VERSION)
+  {
+    char buf[ 64 ];
+    sprintf (buf, "version %u, not %d", (unsigned) h->version,
+             FUNC_FILE_VERSION);
+    error = buf;
+  }
+  else if (h->num_vars > ELEM_MAX_INDEX + 1 ||
+           h->num_entries > size / sizeof (uint32_t) ||
+           sizeof (FileHeader) + (size_t) h->num_vars * VAR_NAME_SIZE +
+           (size_t) h->num_entries * sizeof (uint32_t) > size)
+    error = "truncated";
+  else
+    error = "";
+
+  // the table names the variables, so that a file stays readable even
+  // if they are numbered differently by then
+  const char *names = (const char*) (data + sizeof (FileHeader));
+  for (int i = 0; error.empty() && i < h->num_vars; i++)
+  {
+    const char *name = names + i * VAR_NAME_SIZE;
+    if (memchr (name, '\0', VAR_NAME_SIZE) == NULL)
+    {
+      error = "bad variable table";
+      break;
+    }
+
+    int v = 0;
+    while (v < NUM_VALUES && strcmp (name, var_names[v]) != 0)
+      v++;
+    if (v == NUM_VALUES)
+      error = string ("unknown variable ") + name;
+    else
+      vars.push_back ((var_enum) v);
+  }
+
+  if (!error.empty())
+  {
+    close();
+    return false;
+  }
+
+  num_entries = h->num_entries;
+  return true;
+}
+
+void
+FunctionFile::close (void)
+{
+  if (data)
+    munmap ((void*) data, size);
+  data = NULL;
+  size = 0;
+  num_entries = 0;
+  vars.clear();
+}
+
+// where record i begins, and how long its source is; NULL if it is out
+// of the file
+const unsigned char *
+FunctionFile::get_record (int i, int& source_len) const
+{
+  if (i < 0 || i >= num_entries)
+    return NULL;
+
+  const uint32_t *offsets =
+    (const uint32_t*) (data + sizeof (FileHeader) + vars.size() * VAR_NAME_SIZE);
+  size_t offset = offsets[i];
+  if (offset % 8 != 0 || offset > size - sizeof (RecordHeader))
+    return NULL;
+
+  const RecordHeader *h = (const RecordHeader*) (data + offset);
+  if (h->source_len > size - offset - sizeof (RecordHeader))
+    return NULL;
+
+  source_len = h->source_len;
+  return data + offset;
+}
+
+// the block at p into f (if not NULL), p moving past it; false if it
+// runs out of the file or isn't a well formed RPN
+bool
+FunctionFile::get_block (const unsigned char *& p, Function *f) const
+{
+  const unsigned char *end = data + size;
+  if (end - p < (ptrdiff_t) sizeof (BlockHeader))
+    return false;
+
+  const BlockHeader *h = (const BlockHeader*) p;
+  size_t left = end - p - sizeof (BlockHeader);
+  if (h->num_consts > left / sizeof (double) ||
+      h->num_code > (left - h->num_consts * sizeof (double)) /
+                    sizeof (uint16_t) ||
+      h->num_code == 0)
+    return false;
+
+  const double *consts = (const double*) (p + sizeof (BlockHeader));
+  const uint16_t *code = (const uint16_t*) (consts + h->num_consts);
+  p = (const unsigned char*) consts +
+      align8 (h->num_consts * sizeof (double) +
+              h->num_code * sizeof (uint16_t));
+  if (p > end)
+    return false;
+  if (!f)
+    return true;
+
+  vector< Variant > RPN;
+  RPN.reserve (h->num_code);
+  int depth = 0;   // of the evaluation stack
+  for (int i = 0; i < h->num_code; i++)
+  {
+    int index = code[i] & ELEM_MAX_INDEX;
+    switch (code[i] >> ELEM_SHIFT)
+    {
+      case ELEM_CONST:
+        if (index >= h->num_consts)
+          return false;
+        RPN.push_back (Variant (consts[ index ]));
+        depth++;
+        break;
+
+      case ELEM_VAR:
+        if (index >= vars.size())
+          return false;
+        RPN.push_back (Variant (vars[ index ]));
+        depth++;
+        break;
+
+      case ELEM_OP:
+        // parentheses and d/d never make it into an RPN
+        if (index >= op_openparen)
+          return false;
+        RPN.push_back (Variant ((ops_enum) index));
+        depth -= RPN.back().is_infix_op() ? 1 : 0;
+        if (depth < 1)
+          return false;
+        break;
+
+      default:
+        return false;
+    }
+  }
+  if (depth != 1)
+    return false;
+
+  *f = Function::FromRPN (RPN);
+  return true;
+}
+
+int
+FunctionFile::find (const string& source) const
+{
+  int lo = 0, hi = num_entries;
+  while (lo < hi)
+  {
+    int mid = (lo + hi) / 2;
+    int len;
+    const unsigned char *r = get_record (mid, len);
+    if (!r)
+      return -1;
+
+    int c = compare_source ((const char*) r + sizeof (RecordHeader), len,
+                            source.data(), source.size());
+    if (c == 0)
+      return mid;
+    if (c < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return -1;
+}
+
+string
+FunctionFile::get_source (int i) const
+{
+  int len;
+  const unsigned char *r = get_record (i, len);
+  if (!r)
+    return "";
+  return string ((const char*) r + sizeof (RecordHeader), len);
+}
+
+bool
+FunctionFile::has_derivs (int i) const
+{
+  int len;
+  const unsigned char *r = get_record (i, len);
+  return r && (((const RecordHeader*) r)->flags & REC_DERIVS);
+}
+
+bool
+FunctionFile::get (int i, FunctionEntry& e, bool derivs) const
+{
+  int len;
+  const unsigned char *r = get_record (i, len);
+  if (!r)
+    return false;
+
+  const RecordHeader *h = (const RecordHeader*) r;
+  const unsigned char *p = r + align8 (sizeof (RecordHeader) + len);
+  if (p > data + size)
+    return false;
+
+  // no more functions than the file has room for, however damaged
+  size_t room = (data + size - p) / (sizeof (BlockHeader) + 8);
+  if (h->num_F > room || h->num_Y > room)
+    return false;
+
+  // read into a copy, so that e is left alone if the entry is damaged
+  FunctionEntry got;
+  bool saved = (h->flags & REC_DERIVS);
+  derivs = derivs && saved;
+  got.source.assign ((const char*) r + sizeof (RecordHeader), len);
+  got.F.resize (h->num_F);
+  got.Y.resize (h->num_Y);
+  got.dF.resize (derivs ? 2 * h->num_F : 0);
+
+  for (int k = 0; k < h->num_F; k++)
+  {
+    if (!get_block (p, &got.F[k]))
+      return false;
+    if (saved && (!get_block (p, derivs ? &got.dF[2*k] : NULL) ||
+                  !get_block (p, derivs ? &got.dF[2*k + 1] : NULL)))
+      return false;
+  }
+  for (int k = 0; k < h->num_Y; k++)
+    if (!get_block (p, &got.Y[k]))
+      return false;
+
+  e.source.swap (got.source);
+  e.F.swap (got.F);
+  e.Y.swap (got.Y);
+  e.dF.swap (got.dF);
+  return true;
+}
@@ -0,0 +1,76 @@
+#ifndef _FUNC_FILE_H_
+#define _FUNC_FILE_H_
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "func.h"
+
+// bumped whenever the layout, or the numbering of ops_enum, changes
+#define FUNC_FILE_VERSION 1
+
+// what compile_equations() makes of one text, saved so that it never
+// has to be parsed or differentiated again
+struct FunctionEntry
+{
+  std::string source;                   // the text, as it was typed
+  std::vector< Math::Function > F, Y;   // as compile_equations() left them
+  std::vector< Math::Function > dF;     // dF/dx and dF/dy of each F in
+                                        // turn, or empty
+};
+
+// Writes entries to path, sorted by source, with the derivatives of each
+// F if derivs (computing those not in dF). Each function is stored as
+// its RPN: 16-bit elements naming an operation, a constant of its own
+// constant pool or a variable of the file's variable table. Returns
+// false, with errno set, if writing fails or a function has more than
+// 16383 constants.
+bool write_function_file (const char *path,
+                          const std::vector< FunctionEntry >& entries,
+                          bool derivs);
+
+// A file written by write_function_file(), memory-mapped. Nothing is
+// read until asked for: open() only checks the header and maps the
+// variable table, find() is a binary search over the sources in place,
+// and get() turns one entry's elements straight into Variants. Every
+// offset and element is checked before use, so a damaged file is an
+// error rather than a crash. Once open, it can be read from any thread.
+class FunctionFile
+{
+  const unsigned char *data;
+  size_t size;
+  int num_entries;
+  std::vector< Math::var_enum > vars;   // the file's variable table
+  std::string error;
+
+  const unsigned char *get_record (int i, int& source_len) const;
+  bool get_block (const unsigned char *& p, Math::Function *f) const;
+
+  FunctionFile (const FunctionFile&);
+  FunctionFile& operator= (const FunctionFile&);
+
+public:
+  FunctionFile (void);
+  ~FunctionFile (void);
+
+  // false, with get_error() saying why, if it can't be read or isn't a
+  // file of this version
+  bool open (const char *path);
+  void close (void);
+
+  const std::string& get_error (void) const { return error; }
+
+  int get_num_entries (void) const { return num_entries; }
+
+  // the entry compiled from exactly source, or -1
+  int find (const std::string& source) const;
+
+  std::string get_source (int i) const;
+  bool has_derivs (int i) const;
+
+  // entry i, its dF too if saved and derivs; false, leaving e alone, if
+  // it is damaged
+  bool get (int i, FunctionEntry& e, bool derivs = true) const;
+};
+
+#endif
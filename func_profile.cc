@@ -0,0 +1,200 @@
+/*
+ * func_profile: where evaluating an equation spends its time.
+ *
+ *   func_profile [-w width] [-h height] [-s scale] [-x center_x]
+ *                [-y center_y] [-n passes] equation
+ *
+ * Evaluates the functions of the equation over the view with Function,
+ * at every pixel for F(x,y) = 0 and every column for y = g(x), and
+ * prints each with what its RPN elements cost: per element, and summed
+ * over the text each came from, under the text itself.
+ *
+ * Function only keeps a profile when built with -DFUNC_PROFILE, as this
+ * program and the objects it links are; everything else is built
+ * without it and pays nothing.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "func.h"
+#include "parse.h"
+#include "eqtn.h"
+#include "view.h"
+
+using namespace std;
+using namespace Math;
+
+#ifndef FUNC_PROFILE
+#error func_profile must be built with -DFUNC_PROFILE
+#endif
+
+static string
+element_name (const Variant& v)
+{
+  char buf[ 32 ];
+  switch (v.type)
+  {
+    case Variant::CONSTANT:
+      sprintf (buf, "%g", v.val);
+      return buf;
+    case Variant::VARIABLE:
+      return var_names[ v.var ];
+    default:
+      return op_names[ v.op ];
+  }
+}
+
+// the average cycles of each execution, times how often it ran
+static double
+estimated_cycles (const ProfileEntry& e)
+{
+  return e.samples ? e.cycles / e.samples * e.count : 0.0;
+}
+
+static void
+print_profile (const Function& f)
+{
+  const vector< Variant > RPN = f.get_rpn_stack();
+  const vector< Span >& spans = f.get_spans();
+  const vector< ProfileEntry >& profile = f.get_profile();
+  const string& source = f.get_source();
+
+  double total = 0.0;
+  for (int i = 0; i < profile.size(); i++)
+    total += estimated_cycles (profile[i]);
+  if (total <= 0.0 || profile.empty())
+    return;
+
+  long evals = profile[0].count;
+  printf ("%s\n  %ld evaluations, %.1f cycles each\n\n",
+          source.c_str(), evals, total / evals);
+
+  printf ("  %-10s %-14s %12s %10s %7s\n",
+          "element", "text", "runs", "cycles", "share");
+  for (int i = 0; i < RPN.size(); i++)
+  {
+    const ProfileEntry& e = profile[i];
+    string text = (spans[i].begin == spans[i].end) ? "(implied)" :
+                    source.substr (spans[i].begin,
+                                   spans[i].end - spans[i].begin);
+    if (text.size() > 14)
+      text = text.substr (0, 11) + "...";
+
+    printf ("  %-10s %-14s %12ld %10.1f %6.1f%%\n",
+            element_name (RPN[i]).c_str(), text.c_str(), e.count,
+            e.samples ? e.cycles / e.samples : 0.0,
+            100.0 * estimated_cycles (e) / total);
+  }
+
+  // each element's cost spread over its characters; the implied ones
+  // go to the character after them
+  vector< double > by_char (source.size() + 1, 0.0);
+  for (int i = 0; i < RPN.size(); i++)
+  {
+    int begin = spans[i].begin;
+    int end = max (spans[i].end, begin + 1);
+    for (int k = begin; k < end; k++)
+      by_char[k] += estimated_cycles (profile[i]) / (end - begin);
+  }
+
+  double hottest = *max_element (by_char.begin(), by_char.end());
+  const char *heat = " .:-=+*#%@";
+
+  string marks;
+  for (int k = 0; k < source.size(); k++)
+    marks += heat[ (int)(by_char[k] / hottest * 9.0 + 0.5) ];
+
+  printf ("\n  %s\n  %s\n\n", source.c_str(), marks.c_str());
+}
+
+static void
+usage (void)
+{
+  fprintf (stderr,
+           "usage: func_profile [-w width] [-h height] [-s scale] "
+           "[-x center_x]\n"
+           "                    [-y center_y] [-n passes] equation\n");
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  View view (512, 512, 64.0, 0.0, 0.0);
+  int passes = 1;
+
+  int opt;
+  while ((opt = getopt (argc, argv, "w:h:s:x:y:n:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'w': view.width    = atoi (optarg); break;
+      case 'h': view.height   = atoi (optarg); break;
+      case 's': view.scale    = atof (optarg); break;
+      case 'x': view.center_x = atof (optarg); break;
+      case 'y': view.center_y = atof (optarg); break;
+      case 'n': passes        = atoi (optarg); break;
+      default:  usage();
+    }
+  }
+  if (optind + 1 != argc || view.width <= 0 || view.height <= 0 ||
+      !(view.scale > 0.0) || passes <= 0)
+    usage();
+
+  string text = argv[ optind ];
+  vector< Function > F, Y;
+  try
+  {
+    compile_equations (text, F, Y);
+  }
+  catch (SyntaxException e)
+  {
+    fprintf (stderr, "syntax error at %d: %s\n", e.pos, text.c_str());
+    return 1;
+  }
+  catch (ArgumentException e)
+  {
+    fprintf (stderr, "bad argument at %d-%d: %s\n",
+             e.pos_start, e.pos_end, text.c_str());
+    return 1;
+  }
+
+  // x, y and every parameter, which the equations can't use here (see
+  // Function::operator())
+  double x_y[ NUM_VALUES ] = { 0.0 };
+  volatile double sink = 0.0;   // so nothing is optimized away
+
+  for (int p = 0; p < passes; p++)
+    for (int i = 0; i < view.width; i++)
+    {
+      x_y[0] = view.horiz_px_to_pt (i);
+      x_y[1] = 0.0;
+      for (int k = 0; k < Y.size(); k++)
+        sink += Y[k] (x_y);
+
+      for (int j = 0; j < view.height; j++)
+      {
+        x_y[1] = view.vert_px_to_pt (j);
+        for (int k = 0; k < F.size(); k++)
+          sink += F[k] (x_y);
+      }
+    }
+
+  for (int k = 0; k < Y.size(); k++)
+  {
+    printf ("y = ");
+    print_profile (Y[k]);
+  }
+  for (int k = 0; k < F.size(); k++)
+  {
+    printf ("0 = ");
+    print_profile (F[k]);
+  }
+
+  return 0;
+}
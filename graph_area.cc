@@ -1,9 +1,24 @@
 #include "graph_area.h"
 #include "func.h"
+#include "program.h"
+#include "eqtn.h"
+#include "contour.h"
+#include "grid.h"
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
 
 using namespace std;
 using namespace Gtk;
 
+#define MAX_CACHED_BYTES (32 << 20)   // of levels, all windows together
+#define MAX_CACHED_PROGS 16
+#define MAX_WAIT         0.25         // seconds a frame waits for the
+                                      // focused window's to be drawn
+
+list< GraphArea* > GraphArea::waiting;
+bool GraphArea::idle_running = false;
+
 void
 GraphArea::init (double center_x, double center_y, double scale)
 {
@@ -13,6 +28,50 @@ GraphArea::init (double center_x, double center_y, double scale)
 
   null_func = true;
   grid_active = false;
+  hud_active = false;
+  grid_view.width = 0;   // no grid drawn yet
+  precision = PRECISION_AUTO;
+  shader = Shader (SHADE_GAMMA);
+  fill (params, params + Math::NUM_PARAMS, 0.0);
+  bound = Math::NO_PARAMS;
+
+  obscured = iconified = false;
+  stale = false;
+  focused = false;
+  waiting_since = 0.0;
+  keep_frame = true;
+
+  add_events (Gdk::VISIBILITY_NOTIFY_MASK);
+}
+
+// the pixel format of image, if it is one write_pixels() knows
+static bool
+image_format (const Glib::RefPtr< Gdk::Image >& image,
+              pixel_format_enum& format)
+{
+  const GdkImage  *gi = image->gobj();
+  const GdkVisual *v  = gi->visual;
+
+  if (gi->bpp != 4 || v->type != GDK_VISUAL_TRUE_COLOR ||
+      v->red_mask != 0xFF0000 || v->green_mask != 0xFF00 ||
+      v->blue_mask != 0xFF)
+    return false;
+
+  format = (gi->byte_order == GDK_LSB_FIRST) ? PIXEL_BGRX : PIXEL_XRGB;
+  return true;
+}
+
+void
+GraphArea::create_buffers (int width, int height)
+{
+  img = Gdk::Pixbuf::create (Gdk::COLORSPACE_RGB, false, 8, width, height);
+  levels.resize (width * height);
+
+  // a shared memory image if the server has MIT-SHM, a normal one if not
+  screen = Gdk::Image::create (Gdk::IMAGE_FASTEST, get_visual(),
+                               width, height);
+  if (screen && !image_format (screen, screen_format))
+    screen.clear();
 }
 
 void
@@ -20,19 +79,266 @@ GraphArea::on_realize (void)
 {
   DrawingArea::on_realize();
   
-  img = Gdk::Pixbuf::create (Gdk::COLORSPACE_RGB, false, 8,
-                             get_width(), get_height());
+  create_buffers (get_width(), get_height());
 
-  set_double_buffered (false);  // we always blt from a pixbuf
+  set_double_buffered (false);  // we always blt from our own buffer
   modify_bg (Gtk::STATE_NORMAL, Gdk::Color()); // bg -> black
 }
 
+GraphArea::~GraphArea (void)
+{
+  waiting.remove (this);
+}
+
+void
+GraphArea::on_map (void)
+{
+  DrawingArea::on_map();
+
+  if (stale)
+    request_frame();
+}
+
+bool
+GraphArea::on_visibility_notify_event (GdkEventVisibility *ev)
+{
+  obscured = (ev->state == GDK_VISIBILITY_FULLY_OBSCURED);
+  if (stale)
+    request_frame();
+
+  return false;
+}
+
+void
+GraphArea::set_iconified (bool iconified)
+{
+  this->iconified = iconified;
+  if (stale)
+    request_frame();
+}
+
+void
+GraphArea::request_frame (void)
+{
+  stale = true;
+  if (!is_shown() ||
+      find (waiting.begin(), waiting.end(), this) != waiting.end())
+    return;
+
+  waiting.push_back (this);
+  waiting_since = Perf::now();
+
+  // after GTK's own resizing, which may change what there is to draw
+  if (!idle_running)
+    Glib::signal_idle().connect (SigC::slot (&GraphArea::on_idle),
+                                 Glib::PRIORITY_HIGH_IDLE + 15);
+  idle_running = true;
+}
+
+bool
+GraphArea::on_idle (void)
+{
+  // hidden since they asked; they ask again when shown
+  list< GraphArea* >::iterator it = waiting.begin();
+  while (it != waiting.end())
+    if (!(*it)->is_shown())
+      it = waiting.erase (it);
+    else
+      it++;
+
+  if (!waiting.empty())
+  {
+    list< GraphArea* >::iterator next = waiting.begin();
+    if (Perf::now() - (*next)->waiting_since < MAX_WAIT)
+      for (it = waiting.begin(); it != waiting.end(); it++)
+        if ((*it)->focused)
+        {
+          next = it;
+          break;
+        }
+
+    GraphArea *area = *next;
+    waiting.erase (next);
+    area->draw_frame();
+
+    // on screen before the next window's frame is started
+    area->get_window()->process_updates (false);
+  }
+
+  idle_running = !waiting.empty();
+  return idle_running;
+}
+
+void
+GraphArea::draw_pending (void)
+{
+  if (!stale || !img)
+    return;
+
+  waiting.remove (this);
+  draw_frame();
+  if (is_mapped())
+    get_window()->process_updates (false);
+}
+
+void
+GraphArea::draw_frame (void)
+{
+  stale = false;
+
+  if (null_func)
+  { // just the background, and the grid
+    fill (levels.begin(), levels.end(), 0);
+    compose (0, 0, img->get_width(), img->get_height());
+  }
+  else if (!use_cached_image())
+  {
+    draw_graph (0, 0, img->get_width(), img->get_height());
+    if (keep_frame)
+      set_cached_image (get_image_key(), img->get_width(), img->get_height(),
+                        levels);
+  }
+  keep_frame = true;
+
+  queue_draw();
+}
+
+// FNV-1a, 64 bits
+static void
+hash_bytes (unsigned long long& h, const void *data, size_t size)
+{
+  const unsigned char *p = (const unsigned char*) data;
+  for (size_t i = 0; i < size; i++)
+    h = (h ^ p[i]) * 0x100000001b3ULL;
+}
+
+static void
+hash_funcs (unsigned long long& h, const vector< Math::Function >& funcs)
+{
+  for (int i = 0; i < funcs.size(); i++)
+  {
+    vector< Math::Variant > RPN = funcs[i].get_rpn_stack();
+    for (int k = 0; k < RPN.size(); k++)
+    {
+      int type = RPN[k].type;
+      hash_bytes (h, &type, sizeof (type));
+      if (RPN[k].type == Math::Variant::CONSTANT)
+        hash_bytes (h, &RPN[k].val, sizeof (RPN[k].val));
+      else if (RPN[k].type == Math::Variant::VARIABLE)
+        hash_bytes (h, &RPN[k].var, sizeof (RPN[k].var));
+      else
+        hash_bytes (h, &RPN[k].op, sizeof (RPN[k].op));
+    }
+    hash_bytes (h, "", 1);   // between functions
+  }
+}
+
+// The programs compiled last, by any window, for the equations they were
+// compiled from and whether the gradients are in them; windows showing
+// the same equations, or going back to them, don't compile them again.
+// The most recently used come first.
+struct CachedPrograms
+{
+  unsigned long long hash;   // of F and Y (see hash_funcs())
+  bool distance;
+  vector< Math::Function > F, Y;
+  Math::Program prog, y_prog;
+};
+
+static list< CachedPrograms > cached_programs;
+
+static unsigned long long
+hash_equations (const vector< Math::Function >& F,
+                const vector< Math::Function >& Y)
+{
+  unsigned long long h = 0xcbf29ce484222325ULL;
+  hash_funcs (h, F);
+  hash_funcs (h, Y);
+  return h;
+}
+
+static bool
+same_funcs (const vector< Math::Function >& a,
+            const vector< Math::Function >& b)
+{
+  if (a.size() != b.size())
+    return false;
+
+  for (int i = 0; i < a.size(); i++)
+  {
+    vector< Math::Variant > ra = a[i].get_rpn_stack();
+    vector< Math::Variant > rb = b[i].get_rpn_stack();
+    if (ra.size() != rb.size())
+      return false;
+
+    for (int k = 0; k < ra.size(); k++)
+    {
+      if (ra[k].type != rb[k].type)
+        return false;
+      if (ra[k].type == Math::Variant::CONSTANT
+            ? memcmp (&ra[k].val, &rb[k].val, sizeof (double)) != 0
+            : ra[k].type == Math::Variant::VARIABLE ? ra[k].var != rb[k].var
+                                                    : ra[k].op != rb[k].op)
+        return false;
+    }
+  }
+  return true;
+}
+
+void
+GraphArea::compile (void)
+{
+  unsigned long long hash = hash_equations (F, Y);
+  bool distance = shader.uses_distance();
+
+  list< CachedPrograms >::iterator it;
+  for (it = cached_programs.begin(); it != cached_programs.end(); it++)
+    if (it->hash == hash && it->distance == distance &&
+        same_funcs (it->F, F) && same_funcs (it->Y, Y))
+      break;
+
+  if (it != cached_programs.end())
+  {
+    cached_programs.splice (cached_programs.begin(), cached_programs, it);
+    prog   = it->prog;
+    y_prog = it->y_prog;
+  }
+  else
+  {
+    perf.start (PERF_DERIV);
+    vector< Math::Function > funcs = implicit_functions (F, shader);
+    perf.stop (PERF_DERIV);
+
+    perf.start (PERF_COMPILE);
+    prog   = Math::Program (funcs);
+    y_prog = Math::Program (Y);
+    perf.stop (PERF_COMPILE);
+
+    CachedPrograms c;
+    c.hash = hash;
+    c.distance = distance;
+    c.F = F;
+    c.Y = Y;
+    c.prog = prog;
+    c.y_prog = y_prog;
+    cached_programs.push_front (c);
+    if (cached_programs.size() > MAX_CACHED_PROGS)
+      cached_programs.pop_back();
+  }
+
+  hoisted.clear();
+  for (int p = 0; p < Math::NUM_PARAMS; p++)
+  {
+    prog.bind ((Math::var_enum) (Math::NUM_VARS + p), params[p]);
+    y_prog.bind ((Math::var_enum) (Math::NUM_VARS + p), params[p]);
+  }
+}
+
 bool
 GraphArea::on_configure_event (GdkEventConfigure *ev)
 {
   //TODO: do this the smart way
-  img = Gdk::Pixbuf::create (Gdk::COLORSPACE_RGB, false, 8,
-                             ev->width, ev->height);
+  create_buffers (ev->width, ev->height);
   change_graph (scale, center_x, center_y);
 
   return true;
@@ -41,77 +347,290 @@ GraphArea::on_configure_event (GdkEventConfigure *ev)
 void
 GraphArea::save_img (const string& fn, const string& type, bool save_grid)
 {
-  if (!is_null_func())
+  if (is_null_func())
+    return;
+  if (stale)
+    draw_pending();
+
+  // img only holds the picture on screen when there is no screen image,
+  // and then with the grid as it is on screen
+  bool show_grid = grid_active;
+  grid_active = save_grid;
+  compose_into (img->get_pixels(), img->get_rowstride(),
+                img->get_has_alpha() ? PIXEL_RGBA : PIXEL_RGB,
+                0, 0, img->get_width(), img->get_height());
+  img->save (fn, type);
+
+  grid_active = show_grid;
+  if (!screen && show_grid != save_grid)
+    compose (0, 0, img->get_width(), img->get_height());
+}
+
+void
+GraphArea::save_vector (const string& fn, const string& type)
+{
+  if (is_null_func())
+    return;
+
+  // the explicit equations are traced as F(x,y) = y - Y(x) here
+  vector< Math::Function > all = F;
+  for (int i = 0; i < Y.size(); i++)
+    all.push_back (implicit_form (Y[i]));
+
+  Math::Program all_prog (all);
+  for (int p = 0; p < Math::NUM_PARAMS; p++)
+    all_prog.bind ((Math::var_enum) (Math::NUM_VARS + p), params[p]);
+
+  View view = get_view();
+  vector< Polyline > lines = extract_contours (all_prog, view);
+
+  FILE *f = fopen (fn.c_str(), "w");
+  if (!f)
   {
-    if (!save_grid)
-      img->save (fn, type);
-    else
-    {
-      Glib::RefPtr< Gdk::Pixmap > pmap = Gdk::Pixmap::create
-        (get_window(), (const char*) img->get_pixels(), img->get_width(),
-	 img->get_height(), img->get_bits_per_sample() * img->get_n_channels(),
-	 Gdk::Color(), Gdk::Color());
+    perror (fn.c_str());
+    return;
+  }
 
-      draw_grid (pmap);
+  if (type == "pdf")
+    write_pdf (f, view, lines);
+  else
+    write_svg (f, view, lines);
 
-      Glib::RefPtr< Gdk::Pixbuf > pbuf = Gdk::Pixbuf::create
-	((Glib::RefPtr< Gdk::Drawable >)pmap, pmap->get_colormap(), 0, 0, 0, 0,
-	 img->get_width(), img->get_height());
+  fclose (f);
+}
 
-      pbuf->save (fn, type);
-    }
+void
+GraphArea::save_perf (const string& fn, const string& type)
+{
+  FILE *f = fopen (fn.c_str(), "w");
+  if (!f)
+  {
+    perror (fn.c_str());
+    return;
   }
+
+  if (type == "csv")
+    perf.dump_csv (f);
+  else
+    perf.dump_json (f);
+
+  fclose (f);
 }
 
 void
-GraphArea::draw_grid (Glib::RefPtr< Gdk::Drawable > canvas)
+GraphArea::update_grid (void)
 {
-  int width  = img->get_width();
-  int height = img->get_height();
-    
-  double start_x = ceil (horiz_px_to_pt (0));
-  double start_y = ceil (vert_px_to_pt  (height));
+  View view = get_view();
+  if (grid_view.width == view.width && grid_view.height == view.height &&
+      grid_view.scale == view.scale && grid_view.center_x == view.center_x &&
+      grid_view.center_y == view.center_y)
+  {
+    perf.count (PERF_GRID_HITS);
+    return;
+  }
+  perf.count (PERF_GRID_MISSES);
+
+  grid.resize (view.width * view.height);
+
+  Canvas c;
+  c.buf = &grid[0];
+  c.stride = view.width;
+  c.pixel_size = 1;
+  render_grid (view, c, 0, 0, view.width, view.height);
+
+  grid_view = view;
+}
+
+void
+GraphArea::compose_into (unsigned char *dest, int stride,
+                         pixel_format_enum format,
+                         int x, int y, int width, int height)
+{
+  Canvas c;
+  c.buf = &levels[0];
+  c.stride = img->get_width();
+  c.pixel_size = 1;
+
+  Canvas overlay;
+  if (grid_active)
+  {
+    update_grid();
+    overlay.buf = &grid[0];
+    overlay.stride = grid_view.width;
+    overlay.pixel_size = 1;
+  }
 
-  double end_x = horiz_px_to_pt (width);
-  double end_y = vert_px_to_pt  (0);
+  write_pixels (c, x, y, width, height, colors, format, dest, stride,
+                grid_active ? &overlay : NULL);
+}
+
+void
+GraphArea::compose (int x, int y, int width, int height)
+{
+  if (screen)
+    compose_into ((unsigned char*) screen->gobj()->mem, screen->gobj()->bpl,
+                  screen_format, x, y, width, height);
+  else
+    compose_into (img->get_pixels(), img->get_rowstride(),
+                  img->get_has_alpha() ? PIXEL_RGBA : PIXEL_RGB,
+                  x, y, width, height);
+}
+
+vector< Math::var_enum >
+GraphArea::get_params (void) const
+{
+  vector< Math::var_enum > found = prog.get_params();
+  vector< Math::var_enum > y_found = y_prog.get_params();
+  found.insert (found.end(), y_found.begin(), y_found.end());
+
+  sort (found.begin(), found.end());
+  found.erase (unique (found.begin(), found.end()), found.end());
+  return found;
+}
+
+void
+GraphArea::set_param (Math::var_enum param, double val)
+{
+  params[ param - Math::NUM_VARS ] = val;
+  bound |= Math::param_bit (param);
+  prog.bind (param, val);
+  y_prog.bind (param, val);
 
-  Glib::RefPtr< Gdk::GC > gc = Gdk::GC::create (canvas);
+  // a frame of an animation, most likely, which would only push the
+  // frames worth keeping out of the cache
+  change_graph (scale, center_x, center_y);
+  keep_frame = false;
+}
 
-  Gdk::Color line_color;
-  line_color.set_rgb_p (0.5, 0.5, 0.5);
+string
+GraphArea::get_image_key (void) const
+{
+  unsigned long long h = 0xcbf29ce484222325ULL;
 
-  Gdk::Screen::get_default()->get_default_colormap()->alloc_color(line_color);
-  gc->set_foreground (line_color);
+  hash_bytes (h, &null_func, sizeof (null_func));
+  hash_bytes (h, &scale, sizeof (scale));
+  hash_bytes (h, &center_x, sizeof (center_x));
+  hash_bytes (h, &center_y, sizeof (center_y));
+  hash_bytes (h, &precision, sizeof (precision));
+  shading_enum curve = shader.get_curve();
+  hash_bytes (h, &curve, sizeof (curve));
 
-  for (double x = start_x; x < end_x; x++)
+  // only the parameters drawn with; the others may be anything
+  vector< Math::var_enum > used = get_params();
+  for (int i = 0; i < used.size(); i++)
   {
-    int i = horiz_pt_to_px (x);
-    gc->set_line_attributes (1, 
-	                     (x == 0.0) ? 
-		               Gdk::LINE_SOLID : Gdk::LINE_ON_OFF_DASH,
-			       Gdk::CAP_NOT_LAST, Gdk::JOIN_MITER);
-    canvas->draw_line (gc, i, 0, i, height);
+    hash_bytes (h, &used[i], sizeof (used[i]));
+    hash_bytes (h, &params[ used[i] - Math::NUM_VARS ], sizeof (double));
   }
 
-  for (double y = start_y; y < end_y; y++)
+  hash_funcs (h, F);
+  hash_bytes (h, "|", 1);
+  hash_funcs (h, Y);
+
+  char buf[ 20 ];
+  sprintf (buf, "%016llx", h);
+  return buf;
+}
+
+bool
+GraphArea::get_image (vector< unsigned char >& levels,
+                      int& width, int& height) const
+{
+  if (!img || null_func || stale)
+    return false;
+
+  levels = this->levels;
+  width = img->get_width();
+  height = img->get_height();
+  return true;
+}
+
+// The levels last drawn, by any window, for the graph they show; the
+// most recently used come first, and the least go once they take more
+// than MAX_CACHED_BYTES.
+struct CachedImage
+{
+  string key;
+  int width, height;
+  vector< unsigned char > levels;
+};
+
+static list< CachedImage > cached_images;
+static size_t cached_bytes = 0;
+
+// the image of key at width by height, now the most recently used; or
+// cached_images.end()
+static list< CachedImage >::iterator
+find_image (const string& key, int width, int height)
+{
+  list< CachedImage >::iterator it;
+  for (it = cached_images.begin(); it != cached_images.end(); it++)
+    if (it->key == key && it->width == width && it->height == height)
+    {
+      cached_images.splice (cached_images.begin(), cached_images, it);
+      return cached_images.begin();
+    }
+
+  return cached_images.end();
+}
+
+void
+GraphArea::set_cached_image (const string& key, int width, int height,
+                             const vector< unsigned char >& levels)
+{
+  if (levels.size() != width * height ||
+      find_image (key, width, height) != cached_images.end())
+    return;
+
+  cached_images.push_front (CachedImage());
+  CachedImage& c = cached_images.front();
+  c.key = key;
+  c.width = width;
+  c.height = height;
+  c.levels = levels;
+  cached_bytes += levels.size();
+
+  // the one just added stays, however big
+  while (cached_bytes > MAX_CACHED_BYTES && cached_images.size() > 1)
   {
-    int i = vert_pt_to_px (y);
-    gc->set_line_attributes (1, 
-                             (y == 0.0) ? 
-                               Gdk::LINE_SOLID : Gdk::LINE_ON_OFF_DASH, 
-			       Gdk::CAP_NOT_LAST, Gdk::JOIN_MITER);
-    canvas->draw_line (gc, 0, i, width, i);
+    cached_bytes -= cached_images.back().levels.size();
+    cached_images.pop_back();
   }
 }
 
+bool
+GraphArea::use_cached_image (void)
+{
+  if (null_func || cached_images.empty())
+    return false;
+
+  list< CachedImage >::iterator it =
+    find_image (get_image_key(), img->get_width(), img->get_height());
+  if (it == cached_images.end())
+    return false;
+
+  levels = it->levels;
+  compose (0, 0, img->get_width(), img->get_height());
+  return true;
+}
+
+void
+GraphArea::toggle_hud (void)
+{
+  hud_active = !hud_active;
+  queue_draw();
+}
+
 void
 GraphArea::toggle_grid (void)
 {
   grid_active = !grid_active;
-  if (grid_active)
-    draw_grid();
-  else
-    queue_draw();
+  if (!img)
+    return;
+
+  // the curves stay as they are
+  compose (0, 0, img->get_width(), img->get_height());
+  queue_draw();
 }
 
 bool
@@ -132,17 +651,26 @@ GraphArea::on_expose_event (GdkEventExpose *ev)
     int width = (*it).get_width();
     int height = (*it).get_height();
     
-    if (null_func)
-      graph_area_win->draw_rectangle (gc, true, x, y, width, height);
+    if (screen)
+      // already in the server's format, and with MIT-SHM not even copied
+      graph_area_win->draw_image (gc, screen, x, y, x, y, width, height);
     else
       img->render_to_drawable (graph_area_win, gc,
 			       x, y, x, y, width, height,
 			       Gdk::RGB_DITHER_NORMAL, 0, 0);
   }
 
-  if (grid_active)
-    draw_grid();
-  
+  if (hud_active)
+  { // in the corner, over whatever is there
+    Glib::RefPtr< Pango::Layout > layout = create_pango_layout (perf.summary());
+    int width, height;
+    layout->get_pixel_size (width, height);
+
+    graph_area_win->draw_rectangle (get_style()->get_black_gc(), true,
+                                    0, 0, width + 8, height + 8);
+    graph_area_win->draw_layout (get_style()->get_white_gc(), 4, 4, layout);
+  }
+
   return true; // stop further emission of the signal
 }
 
@@ -152,12 +680,12 @@ GraphArea::change_graph (double scale, double center_x, double center_y)
   this->scale = scale;
   this->center_x = center_x;
   this->center_y = center_y;
-  
-  if (!null_func)
-  {
-    draw_graph (0, 0, img->get_width(), img->get_height());
-    queue_draw();
-  }
+
+  if (!img)
+    return;  // not realized yet
+
+  keep_frame = true;
+  request_frame();
 }
 
 void
@@ -3,19 +3,98 @@
 
 #include <gtkmm.h>
 #include <string>
+#include <vector>
+#include <list>
 #include "func.h"
+#include "program.h"
+#include "view.h"
+#include "render.h"
+#include "pixels.h"
+#include "perf.h"
 
 class GraphArea : public Gtk::DrawingArea
 {
   bool null_func;
   bool grid_active;
+  bool hud_active;        // the timings drawn over the graph
   double center_x, center_y;
   double scale;
+  precision_enum precision;
+  Shader shader;
+  Colormap colors;
+
+  std::vector< unsigned char > levels;   // the shade level of every pixel
+
+  // what the window shows, in the format of its visual and in memory the
+  // X server shares when it can; NULL if write_pixels() has no format
+  // for the visual, and img is drawn instead
+  Glib::RefPtr< Gdk::Image > screen;
+  pixel_format_enum screen_format;
+
+  // the grid overlay, a grid_enum per pixel, drawn for grid_view
+  std::vector< unsigned char > grid;
+  View grid_view;
+
+  Perf perf;
+
+  // the values of the parameters, bound into every program compiled;
+  // and the x-only and y-only values of prog kept between frames, so
+  // that changing a parameter redraws little more than the pixels
+  double params[ Math::NUM_PARAMS ];
+  Hoisted hoisted;
+
+  // the parameters given a value with set_param()
+  Math::param_set bound;
+
+  // whether the window shows the graph (see is_shown()), and whether the
+  // levels are out of date: because it didn't when the graph changed,
+  // or because the frame is waiting its turn (see request_frame())
+  bool obscured, iconified;
+  bool stale;
+
+  // whether the window has the keyboard focus, which draws first; when
+  // the frame waiting was asked for; and whether it is kept in the image
+  // cache once drawn, which animation frames aren't
+  bool focused;
+  double waiting_since;
+  bool keep_frame;
+
+  // Every window draws from the one main loop, a frame at a time, so one
+  // window's frame never holds up another's input for long: a change
+  // only queues the window here, and an idle handler draws the windows
+  // queued, the focused one first unless the rest have waited too long.
+  // Windows not shown are left out until they are.
+  static std::list< GraphArea* > waiting;
+  static bool idle_running;
+  static bool on_idle (void);
+
+  void request_frame (void);
+  void draw_frame (void);
+
+  // levels drawn before, by any window, of the graph as it is, into
+  // levels (see set_cached_image())
+  bool use_cached_image (void);
 
   void init (double center_x, double center_y, double scale);
+  void create_buffers (int width, int height);
+
+  // redraws the grid if the view changed since
+  void update_grid (void);
+
+  // turns the levels of a rectangle into colors, with the grid over them
+  // if it is on, into the screen image or img
+  void compose (int x, int y, int width, int height);
+  void compose_into (unsigned char *dest, int stride,
+                     pixel_format_enum format,
+                     int x, int y, int width, int height);
   
+  void compile (void);
+
 public:
-  Math::Function F;
+  std::vector< Math::Function > F;   // overlaid equations, F(x,y) = 0
+  std::vector< Math::Function > Y;   // overlaid equations, y = Y(x)
+  Math::Program prog;                // all of F, fused (see compile_implicit)
+  Math::Program y_prog;              // all of Y, fused
   Glib::RefPtr< Gdk::Pixbuf > img;
 
   GraphArea (double scale)
@@ -23,14 +102,25 @@ public:
     init (0.0, 0.0, scale);
   }
 
+  virtual ~GraphArea (void);
+
   GraphArea (const GraphArea& other)
   {
     init (other.center_x, other.center_y, other.scale);
     
     null_func   = other.null_func;
     grid_active = other.grid_active;
+    hud_active  = other.hud_active;
+    precision   = other.precision;
+    shader      = other.shader;
+    colors      = other.colors;
     
     F = other.F;
+    Y = other.Y;
+    prog = other.prog;
+    y_prog = other.y_prog;
+    std::copy (other.params, other.params + Math::NUM_PARAMS, params);
+    bound = other.bound;
   }
 
   GraphArea& operator= (const GraphArea& other)
@@ -42,31 +132,125 @@ public:
     scale     = other.scale;
     null_func = other.null_func;
     grid_active = other.grid_active;
+    hud_active = other.hud_active;
+    precision = other.precision;
+    shader = other.shader;
+    colors = other.colors;
     F = other.F;
+    Y = other.Y;
+    prog = other.prog;
+    y_prog = other.y_prog;
+    std::copy (other.params, other.params + Math::NUM_PARAMS, params);
+    bound = other.bound;
+    hoisted.clear();
     
     return *this;
   }
 
   bool           is_null_func (void) const { return null_func; }
-  Math::Function get_func     (void) const { return F; }
+  std::vector< Math::Function > get_funcs (void) const { return F; }
   double         get_center_x (void) const { return center_x; }
   double         get_center_y (void) const { return center_y; }
   double         get_scale    (void) const { return scale; }
   bool           has_grid     (void) const { return grid_active; }
+  bool           has_hud      (void) const { return hud_active; }
+  shading_enum   get_shading  (void) const { return shader.get_curve(); }
+
+  // the timings of this window, for whoever does work on its behalf
+  Perf& get_perf (void) { return perf; }
+
+  View get_view (void) const
+  {
+    return View (img->get_width(), img->get_height(),
+                 scale, center_x, center_y);
+  }
   
+  // the parameters the equations use, in order
+  std::vector< Math::var_enum > get_params (void) const;
+  double get_param (Math::var_enum param) const
+  { return params[ param - Math::NUM_VARS ]; }
+
+  // redraws with param bound to val; nothing is compiled again
+  void set_param (Math::var_enum param, double val);
+  Math::param_set get_bound_params (void) const { return bound; }
+
+  // whether any of the graph is on screen. While none is, changes are
+  // only noted, and drawn once some is again.
+  bool is_shown (void) const
+  { return is_mapped() && !obscured && !iconified; }
+  void set_iconified (bool iconified);
+
+  // the focused window's frames are drawn before the others'
+  bool is_focused (void) const { return focused; }
+  void set_focused (bool focused) { this->focused = focused; }
+
+  // the frame waiting, drawn and on screen now rather than in its turn
+  void draw_pending (void);
+
+  // what the levels show: the equations, the view but for its size, the
+  // parameters and everything else drawing depends on, hashed
+  std::string get_image_key (void) const;
+
+  // the levels, if they show the graph as it is now
+  bool get_image (std::vector< unsigned char >& levels,
+                  int& width, int& height) const;
+
+  // width by height levels drawn before of the graph whose key is key,
+  // into the image cache every window shares: if that graph comes up in
+  // any of them at that size, they are shown instead of drawing it again
+  static void set_cached_image (const std::string& key,
+                                int width, int height,
+                                const std::vector< unsigned char >& levels);
+
   void toggle_grid();
+  void toggle_hud();
+  void set_precision (precision_enum precision)
+  {
+    this->precision = precision;
+    change_graph (scale, center_x, center_y);
+  }
+  // the distance curve needs the gradients, so changing to or from it
+  // recompiles the equations
+  void set_shading (shading_enum curve)
+  {
+    if (curve == shader.get_curve())
+      return;
+
+    bool recompile = (Shader (curve).uses_distance() != shader.uses_distance());
+    shader = Shader (curve);
+    if (recompile)
+      compile();
+    change_graph (scale, center_x, center_y);
+  }
+  void set_colormap (const Colormap& colors)
+  {
+    this->colors = colors;
+    change_graph (scale, center_x, center_y);
+  }
   void set_null_func()
   {
     null_func = true;
-    queue_draw();
+    change_graph (scale, center_x, center_y);
   }
   
   void change_graph (double scale, double center_x, double center_y);
   void change_graph (double scale, double center_x, double center_y,
                      Math::Function& F)
+  {
+    change_graph (scale, center_x, center_y,
+                  std::vector< Math::Function > (1, F));
+  }
+  // the explicit equations in Y are traced column by column instead of
+  // being tested at every pixel
+  void change_graph (double scale, double center_x, double center_y,
+                     const std::vector< Math::Function >& F,
+                     const std::vector< Math::Function >& Y =
+                       std::vector< Math::Function >())
   {
     null_func = false;
     this->F = F;
+    this->Y = Y;
+    compile();
     
     change_graph (scale, center_x, center_y);
   }
@@ -76,6 +260,12 @@ public:
   void save_img (const std::string& filename, const std::string& type,
                  bool save_grid = false);
 
+  // the curves as paths instead of pixels; type is "svg" or "pdf"
+  void save_vector (const std::string& filename, const std::string& type);
+
+  // the timings of the session so far; type is "csv" or "json"
+  void save_perf (const std::string& filename, const std::string& type);
+
   // pixels to logical points
   double horiz_px_to_pt (int x)
   { return ((double)(x - img->get_width()/2)) / scale + center_x; }
@@ -92,13 +282,11 @@ public:
 
 protected:
   virtual void on_realize         (void);
+  virtual void on_map             (void);
   virtual bool on_configure_event (GdkEventConfigure *ev);
   virtual bool on_expose_event    (GdkEventExpose *ev);
+  virtual bool on_visibility_notify_event (GdkEventVisibility *ev);
 
-  void draw_grid (Glib::RefPtr< Gdk::Drawable > canvas);
-  void draw_grid (void)
-  { draw_grid (get_window()); }
-  
   void draw_graph (int x, int y, int width, int height);
 };
 
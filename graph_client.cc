@@ -0,0 +1,318 @@
+/*
+ * graph_client: talks to graph_server.
+ *
+ *   graph_client [-s socket] [-w width] [-h height] [-z scale]
+ *                [-x center_x] [-y center_y] -o out.png equation
+ *     renders one image
+ *   graph_client [-s socket] [-w width] [-h height] [-z scale]
+ *                -n requests [-c connections] [-p positions] equation...
+ *     load test: the requests are spread over the connections, each
+ *     asking for one of the equations panned to one of 'positions'
+ *     places at random, so that some of them hit the server's caches.
+ *     Prints the latencies and throughput, then the server's counters.
+ *   graph_client [-s socket] -t
+ *     prints the server's counters
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+#define DEFAULT_SOCKET "/tmp/grapher.sock"
+
+static double
+now (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static int
+connect_to (const string& path)
+{
+  struct sockaddr_un addr;
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  strncpy (addr.sun_path, path.c_str(), sizeof (addr.sun_path) - 1);
+
+  int fd = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect (fd, (struct sockaddr*) &addr, sizeof (addr)) != 0)
+  {
+    perror (path.c_str());
+    exit (1);
+  }
+  return fd;
+}
+
+static bool
+write_all (int fd, const void *data, size_t size)
+{
+  const char *p = (const char*) data;
+  while (size > 0)
+  {
+    ssize_t n = write (fd, p, size);
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+static bool
+read_all (int fd, void *data, size_t size)
+{
+  char *p = (char*) data;
+  while (size > 0)
+  {
+    ssize_t n = read (fd, p, size);
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+// sends one request line and reads the answer: "PNG" or "STATS" with
+// its body in data, or "ERROR" with the message in data. Returns the
+// kind, or "" if the connection broke.
+static string
+request (int fd, const string& line, string& data)
+{
+  string msg = line + "\n";
+  if (!write_all (fd, msg.data(), msg.size()))
+    return "";
+
+  // the header line, a byte at a time so nothing past it is consumed
+  string head;
+  char c;
+  while (read (fd, &c, 1) == 1 && c != '\n')
+    head += c;
+  if (c != '\n')
+    return "";
+
+  string kind = head.substr (0, head.find (' '));
+  string rest = head.size() > kind.size() ? head.substr (kind.size() + 1) : "";
+
+  if (kind == "ERROR")
+  {
+    data = rest;
+    return kind;
+  }
+
+  data.resize (atol (rest.c_str()));
+  if (!data.empty() && !read_all (fd, &data[0], data.size()))
+    return "";
+  return kind;
+}
+
+static string
+render_line (int w, int h, double scale, double cx, double cy,
+             const string& equation)
+{
+  char buf[ 128 ];
+  sprintf (buf, "RENDER %d %d %.17g %.17g %.17g ", w, h, scale, cx, cy);
+  return buf + equation;
+}
+
+struct LoadTest
+{
+  string path;
+  int width, height;
+  double scale;
+  vector< string > equations;
+  int positions;
+
+  int requests;                // for each connection
+  unsigned seed;
+  vector< double > latencies;
+  long bytes, errors;
+};
+
+static void *
+load_thread (void *arg)
+{
+  LoadTest *t = (LoadTest*) arg;
+  int fd = connect_to (t->path);
+
+  for (int i = 0; i < t->requests; i++)
+  {
+    const string& eq = t->equations[ rand_r (&t->seed) % t->equations.size() ];
+    int pos = rand_r (&t->seed) % t->positions;
+
+    // neighbouring views, as a user panning around would ask for
+    double cx = (pos % 8) * t->width / t->scale;
+    double cy = (pos / 8) * t->height / t->scale;
+
+    string data;
+    double start = now();
+    string kind = request (fd, render_line (t->width, t->height, t->scale,
+                                            cx, cy, eq), data);
+    t->latencies.push_back (now() - start);
+
+    if (kind == "PNG")
+      t->bytes += data.size();
+    else
+      t->errors++;
+    if (kind.empty())
+      break;
+  }
+
+  close (fd);
+  return NULL;
+}
+
+static void
+print_stats (const string& path)
+{
+  int fd = connect_to (path);
+  string data;
+  if (request (fd, "STATS", data) == "STATS")
+    fputs (data.c_str(), stdout);
+  close (fd);
+}
+
+static void
+usage (void)
+{
+  fprintf (stderr,
+           "usage: graph_client [-s socket] [-w width] [-h height] "
+           "[-z scale]\n"
+           "                    [-x center_x] [-y center_y] "
+           "-o out.png equation\n"
+           "       graph_client [-s socket] [-w width] [-h height] "
+           "[-z scale]\n"
+           "                    -n requests [-c connections] "
+           "[-p positions] equation...\n"
+           "       graph_client [-s socket] -t\n");
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  string path = DEFAULT_SOCKET;
+  const char *out = NULL;
+  int width = 256, height = 256;
+  double scale = 32, cx = 0, cy = 0;
+  int requests = 0, connections = 8, positions = 16;
+  bool stats_only = false;
+
+  int opt;
+  while ((opt = getopt (argc, argv, "s:w:h:z:x:y:o:n:c:p:t")) != -1)
+  {
+    switch (opt)
+    {
+      case 's': path        = optarg; break;
+      case 'w': width       = atoi (optarg); break;
+      case 'h': height      = atoi (optarg); break;
+      case 'z': scale       = atof (optarg); break;
+      case 'x': cx          = atof (optarg); break;
+      case 'y': cy          = atof (optarg); break;
+      case 'o': out         = optarg; break;
+      case 'n': requests    = atoi (optarg); break;
+      case 'c': connections = atoi (optarg); break;
+      case 'p': positions   = atoi (optarg); break;
+      case 't': stats_only  = true; break;
+      default:  usage();
+    }
+  }
+
+  if (stats_only)
+  {
+    print_stats (path);
+    return 0;
+  }
+
+  if (optind == argc || connections <= 0 || positions <= 0)
+    usage();
+
+  if (out)
+  {
+    int fd = connect_to (path);
+    string data;
+    string kind = request (fd, render_line (width, height, scale, cx, cy,
+                                            argv[ optind ]), data);
+    close (fd);
+
+    if (kind != "PNG")
+    {
+      fprintf (stderr, "%s\n", kind.empty() ? "connection lost"
+                                             : data.c_str());
+      return 1;
+    }
+
+    FILE *f = fopen (out, "wb");
+    if (!f || fwrite (data.data(), 1, data.size(), f) != data.size() ||
+        fclose (f) != 0)
+    {
+      perror (out);
+      return 1;
+    }
+    return 0;
+  }
+
+  if (requests <= 0)
+    usage();
+
+  vector< LoadTest > tests (connections);
+  for (int i = 0; i < connections; i++)
+  {
+    LoadTest& t = tests[i];
+    t.path = path;
+    t.width = width;
+    t.height = height;
+    t.scale = scale;
+    t.equations.assign (argv + optind, argv + argc);
+    t.positions = positions;
+    t.requests = requests / connections + (i < requests % connections);
+    t.seed = 12345 + i;
+    t.bytes = t.errors = 0;
+  }
+
+  double start = now();
+  vector< pthread_t > tids (connections);
+  for (int i = 0; i < connections; i++)
+    pthread_create (&tids[i], NULL, load_thread, &tests[i]);
+  for (int i = 0; i < connections; i++)
+    pthread_join (tids[i], NULL);
+  double elapsed = now() - start;
+
+  vector< double > all;
+  long bytes = 0, errors = 0;
+  for (int i = 0; i < connections; i++)
+  {
+    all.insert (all.end(), tests[i].latencies.begin(),
+                tests[i].latencies.end());
+    bytes += tests[i].bytes;
+    errors += tests[i].errors;
+  }
+  sort (all.begin(), all.end());
+
+  if (all.empty())
+    return 1;
+
+  printf ("%d requests over %d connections in %.2f s, %ld errors\n",
+          (int) all.size(), connections, elapsed, errors);
+  printf ("throughput %.1f requests/s, %.1f MB/s\n",
+          all.size() / elapsed, bytes / elapsed / 1e6);
+  printf ("latency ms: p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+          all[ all.size() / 2 ] * 1e3, all[ all.size() * 9 / 10 ] * 1e3,
+          all[ all.size() * 99 / 100 ] * 1e3, all.back() * 1e3);
+  printf ("\nserver:\n");
+  print_stats (path);
+
+  return errors != 0;
+}
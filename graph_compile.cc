@@ -0,0 +1,287 @@
+/*
+ * graph_compile: compiles equations ahead of time into a function file
+ * (see func_file.h), which loads without parsing.
+ *
+ *   graph_compile [-n] [-p params] output.gfn [equations.txt]
+ *   graph_compile -l file.gfn
+ *   graph_compile -t file.gfn
+ *
+ * The equations are one per line (or "eq1; eq2" per line), from the
+ * file or standard input; blank lines and lines starting with # are
+ * skipped, and lines that don't compile are reported and left out. The
+ * derivatives the distance shader needs are stored too, unless -n. The
+ * equations may use the parameters named by -p, e.g. -p ak for a and k,
+ * and no others.
+ *
+ * -l lists the equations of a file. -t loads all of it, then compiles
+ * the same equations from their text, and prints how long each took and
+ * whether both give the same values.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <string>
+#include <vector>
+
+#include "func.h"
+#include "parse.h"
+#include "eqtn.h"
+#include "func_file.h"
+
+using namespace std;
+using namespace Math;
+
+#define MAX_LINE 8192
+
+static void
+usage (void)
+{
+  fprintf (stderr,
+           "usage: graph_compile [-n] [-p params] output.gfn [equations.txt]\n"
+           "       graph_compile -l file.gfn\n"
+           "       graph_compile -t file.gfn\n");
+  exit (1);
+}
+
+static double
+now (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// e from its source, the slow way; false if it doesn't compile
+static bool
+compile_entry (FunctionEntry& e, bool derivs, param_set params)
+{
+  try
+  {
+    string text = e.source;
+    compile_equations (text, e.F, e.Y, params);
+  }
+  catch (SyntaxException)
+  {
+    return false;
+  }
+  catch (ArgumentException)
+  {
+    return false;
+  }
+
+  e.dF.clear();
+  for (int i = 0; derivs && i < e.F.size(); i++)
+  {
+    e.dF.push_back (e.F[i].differentiate (var_x));
+    e.dF.push_back (e.F[i].differentiate (var_y));
+  }
+  return true;
+}
+
+// "ak" into the parameters a and k; false if a letter isn't one
+static bool
+parse_params (const char *arg, param_set& params)
+{
+  for (; *arg; arg++)
+  {
+    int v = NUM_VARS;
+    while (v < NUM_VALUES && var_names[v] != string (1, *arg))
+      v++;
+    if (v == NUM_VALUES)
+      return false;
+    params |= param_bit ((var_enum) v);
+  }
+  return true;
+}
+
+static int
+compile_file (const char *out, FILE *in, bool derivs, param_set params)
+{
+  vector< FunctionEntry > entries;
+  int line_no = 0, failed = 0;
+  char line[ MAX_LINE ];
+  double start = now();
+  while (fgets (line, sizeof (line), in))
+  {
+    line_no++;
+    line[ strcspn (line, "\r\n") ] = '\0';
+    if (line[0] == '\0' || line[0] == '#')
+      continue;
+
+    FunctionEntry e;
+    e.source = line;
+    if (!compile_entry (e, derivs, params))
+    {
+      fprintf (stderr, "line %d: can't compile \"%s\"\n", line_no, line);
+      failed++;
+      continue;
+    }
+    entries.push_back (e);
+  }
+  double compiled = now();
+
+  if (!write_function_file (out, entries, derivs))
+  {
+    perror (out);
+    return 1;
+  }
+
+  printf ("%d equations (%d left out) compiled in %.1f ms, "
+          "written in %.1f ms\n",
+          (int) entries.size(), failed, (compiled - start) * 1e3,
+          (now() - compiled) * 1e3);
+  return 0;
+}
+
+static bool
+same (double a, double b)
+{
+  return a == b || (a != a && b != b);
+}
+
+// whether f and g agree at a few points, every parameter set to 0.5
+static bool
+same_values (const Function& f, const Function& g)
+{
+  static const double points[][2] = {
+    { 0.3, -1.7 }, { 2.5, 0.25 }, { -3.1, 4.2 }
+  };
+
+  double vars[ NUM_VALUES ];
+  for (int v = 0; v < NUM_VALUES; v++)
+    vars[v] = 0.5;
+  for (int k = 0; k < sizeof (points) / sizeof (points[0]); k++)
+  {
+    vars[ var_x ] = points[k][0];
+    vars[ var_y ] = points[k][1];
+    if (!same (f (vars), g (vars)))
+      return false;
+  }
+  return true;
+}
+
+static bool
+same_functions (const vector< Function >& a, const vector< Function >& b)
+{
+  if (a.size() != b.size())
+    return false;
+  for (int i = 0; i < a.size(); i++)
+    if (!same_values (a[i], b[i]))
+      return false;
+  return true;
+}
+
+static int
+test_file (const FunctionFile& file)
+{
+  int n = file.get_num_entries();
+  vector< FunctionEntry > loaded (n);
+  vector< bool > ok (n);
+  int damaged = 0, functions = 0;
+
+  double start = now();
+  for (int i = 0; i < n; i++)
+    if (!(ok[i] = file.get (i, loaded[i])))
+      damaged++;
+  double load_time = now() - start;
+
+  vector< FunctionEntry > parsed (n);
+  start = now();
+  for (int i = 0; i < n; i++)
+  {
+    // with the parameters it was compiled with
+    parsed[i].source = file.get_source (i);
+    compile_entry (parsed[i], file.has_derivs (i),
+                   used_params (loaded[i].F) | used_params (loaded[i].Y));
+  }
+  double parse_time = now() - start;
+
+  int differ = 0;
+  for (int i = 0; i < n; i++)
+  {
+    if (!ok[i])
+    {
+      fprintf (stderr, "damaged: %s\n", parsed[i].source.c_str());
+      continue;
+    }
+
+    functions += loaded[i].F.size() + loaded[i].Y.size() +
+                 loaded[i].dF.size();
+    if (!same_functions (loaded[i].F, parsed[i].F) ||
+        !same_functions (loaded[i].Y, parsed[i].Y) ||
+        !same_functions (loaded[i].dF, parsed[i].dF))
+    {
+      fprintf (stderr, "differs: %s\n", loaded[i].source.c_str());
+      differ++;
+    }
+  }
+
+  printf ("%d equations, %d functions\n", n, functions);
+  printf ("loaded   in %8.2f ms\n", load_time * 1e3);
+  printf ("compiled in %8.2f ms\n", parse_time * 1e3);
+  printf ("%d damaged, %d differ\n", damaged, differ);
+  return (damaged || differ) ? 1 : 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  bool derivs = true, list = false, test = false;
+  param_set params = NO_PARAMS;
+
+  int opt;
+  while ((opt = getopt (argc, argv, "nlp:t")) != -1)
+  {
+    switch (opt)
+    {
+      case 'n': derivs = false; break;
+      case 'p':
+        if (!parse_params (optarg, params))
+          usage();
+        break;
+      case 'l': list   = true;  break;
+      case 't': test   = true;  break;
+      default:  usage();
+    }
+  }
+  int args = argc - optind;
+  if ((list || test) ? (args != 1 || list == test || !derivs || params)
+                     : (args < 1 || args > 2))
+    usage();
+
+  if (list || test)
+  {
+    FunctionFile file;
+    double start = now();
+    if (!file.open (argv[ optind ]))
+    {
+      fprintf (stderr, "%s: %s\n", argv[ optind ], file.get_error().c_str());
+      return 1;
+    }
+    double open_time = now() - start;
+
+    if (test)
+    {
+      printf ("opened   in %8.2f ms\n", open_time * 1e3);
+      return test_file (file);
+    }
+
+    for (int i = 0; i < file.get_num_entries(); i++)
+      printf ("%s\n", file.get_source (i).c_str());
+    return 0;
+  }
+
+  FILE *in = stdin;
+  if (args == 2 && !(in = fopen (argv[ optind + 1 ], "r")))
+  {
+    perror (argv[ optind + 1 ]);
+    return 1;
+  }
+  int status = compile_file (argv[ optind ], in, derivs, params);
+  if (in != stdin)
+    fclose (in);
+  return status;
+}
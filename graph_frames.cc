@@ -0,0 +1,466 @@
+/*
+ * graph_frames: renders a parameter sweep as a sequence of frames.
+ *
+ *   graph_frames [-w width] [-h height] [-s scale] [-x center_x]
+ *                [-y center_y] [-p name=value]... [-a name=from,to]
+ *                [-n frames] [-r rate] [-j threads] [-d]
+ *                equation output
+ *
+ * -a varies a parameter of the equation evenly from 'from' to 'to' over
+ * the frames (60 by default); -p binds others to a fixed value. The
+ * equation can use no parameter that is neither. The output is either a
+ * printf pattern for numbered PNGs, like "frame%04d.png", or a raw
+ * YUV4MPEG2 stream (4:2:0, at -r frames per second, 30 by default) into
+ * a file ending in .y4m or, for "-", to stdout, which a video encoder
+ * can read as it comes:
+ *
+ *   graph_frames -a a=0,6.28 -n 300 "sin(x+a) = y" - | ffmpeg -i - out.mp4
+ *
+ * Frames are shared out between the threads (-j, default one per
+ * processor) a frame at a time, each thread with copies of the programs
+ * to bind its parameter in, and its own hoisted x-only and y-only
+ * values, which stay valid from frame to frame. The stream is written in
+ * order; a frame done early waits, but no thread gets more than a few
+ * frames ahead. -d shades by the distance to the curves.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "func.h"
+#include "parse.h"
+#include "program.h"
+#include "eqtn.h"
+#include "view.h"
+#include "render.h"
+#include "shade.h"
+#include "pixels.h"
+#include "png_stream.h"
+
+using namespace std;
+using namespace Math;
+
+#define AHEAD 2   // frames each thread may render past the one written
+
+static void
+usage (void)
+{
+  fprintf (stderr,
+           "usage: graph_frames [-w width] [-h height] [-s scale]\n"
+           "                    [-x center_x] [-y center_y]\n"
+           "                    [-p name=value]... [-a name=from,to]\n"
+           "                    [-n frames] [-r rate] [-j threads] [-d]\n"
+           "                    equation {pattern%%d.png,output.y4m,-}\n");
+  exit (1);
+}
+
+// the parameter called name, if there is one
+static bool
+find_param (const string& name, var_enum& param)
+{
+  for (int v = NUM_VARS; v < NUM_VALUES; v++)
+    if (name == var_names[v])
+    {
+      param = (var_enum) v;
+      return true;
+    }
+
+  return false;
+}
+
+// "a=1.5" into params, and a into declared; false if it isn't a
+// parameter and a number
+static bool
+parse_binding (const char *arg, double *params, param_set& declared)
+{
+  const char *eq = strchr (arg, '=');
+  var_enum param;
+  if (!eq || !find_param (string (arg, eq - arg), param))
+    return false;
+
+  char *end;
+  double val = strtod (eq + 1, &end);
+  if (end == eq + 1 || *end != '\0')
+    return false;
+
+  params[ param - NUM_VARS ] = val;
+  declared |= param_bit (param);
+  return true;
+}
+
+// "a=0,6.28" into the parameter swept and its range
+static bool
+parse_sweep (const char *arg, var_enum& param, double& from, double& to)
+{
+  const char *eq = strchr (arg, '=');
+  if (!eq || !find_param (string (arg, eq - arg), param))
+    return false;
+
+  char c;
+  return sscanf (eq + 1, "%lf,%lf%c", &from, &to, &c) == 2;
+}
+
+struct Sweep
+{
+  Program prog, y_prog;   // with the fixed parameters bound
+  Shader shader;
+  Colormap colors;
+  View view;
+
+  bool swept;
+  var_enum param;
+  double from, to;
+  int num_frames;
+
+  string pattern;         // of the PNGs' names, if not a stream
+  FILE *stream;           // the Y4M stream, NULL for PNGs
+
+  int next_frame;         // the next to render
+  int next_write;         // the next to go into the stream
+  int window;             // frames rendered ahead of it, at most
+  map< int, vector< unsigned char > > done;   // waiting to be written
+  int failed;
+  pthread_mutex_t lock;
+  pthread_cond_t  written;
+
+  double value (int k) const;
+  void put (int k, vector< unsigned char >& yuv);
+};
+
+double
+Sweep::value (int k) const
+{
+  return (num_frames < 2) ? from :
+                            from + (to - from) * k / (num_frames - 1);
+}
+
+// a frame for the stream: it goes out once all the ones before it have;
+// called with the lock held
+void
+Sweep::put (int k, vector< unsigned char >& yuv)
+{
+  done[k].swap (yuv);
+
+  map< int, vector< unsigned char > >::iterator it;
+  while ((it = done.find (next_write)) != done.end())
+  {
+    if (fputs ("FRAME\n", stream) == EOF ||
+        fwrite (&it->second[0], 1, it->second.size(), stream) !=
+          it->second.size())
+      failed++;
+
+    // the caller can reuse its buffer once it's written
+    if (it->first == k)
+      yuv.swap (it->second);
+    done.erase (it);
+    next_write++;
+  }
+
+  pthread_cond_broadcast (&written);
+}
+
+static inline unsigned char
+clamp_byte (double v)
+{
+  return (unsigned char) ((v < 0.0) ? 0 : (v > 255.0) ? 255 : v + 0.5);
+}
+
+// RGB to the planes of 4:2:0 YCbCr with full range ("C420jpeg"), each
+// chroma sample the average of a 2x2 block
+static void
+rgb_to_yuv420 (const unsigned char *rgb, int width, int height,
+               vector< unsigned char >& yuv)
+{
+  int cw = width / 2, ch = height / 2;
+  yuv.resize (width * height + 2 * cw * ch);
+
+  unsigned char *Y = &yuv[0];
+  unsigned char *U = Y + width * height;
+  unsigned char *V = U + cw * ch;
+
+  for (int i = 0; i < width * height; i++)
+  {
+    const unsigned char *p = rgb + 3*i;
+    Y[i] = clamp_byte (0.299 * p[0] + 0.587 * p[1] + 0.114 * p[2]);
+  }
+
+  for (int j = 0; j < ch; j++)
+    for (int i = 0; i < cw; i++)
+    {
+      int r = 0, g = 0, b = 0;
+      for (int k = 0; k < 4; k++)
+      {
+        const unsigned char *p =
+          rgb + 3 * ((2*j + (k >> 1)) * width + 2*i + (k & 1));
+        r += p[0];
+        g += p[1];
+        b += p[2];
+      }
+
+      U[ j*cw + i ] = clamp_byte (128.0 + (-0.168736 * r - 0.331264 * g +
+                                           0.5 * b) / 4);
+      V[ j*cw + i ] = clamp_byte (128.0 + (0.5 * r - 0.418688 * g -
+                                           0.081312 * b) / 4);
+    }
+}
+
+static void *
+worker (void *p)
+{
+  Sweep& s = *(Sweep*) p;
+  const View& view = s.view;
+
+  // this thread's own: the programs to bind the parameter in, the values
+  // hoisted out of the pixels, and the buffers
+  Program prog = s.prog, y_prog = s.y_prog;
+  Hoisted hoisted;
+  vector< unsigned char > levels, rgb, yuv;
+
+  for (;;)
+  {
+    pthread_mutex_lock (&s.lock);
+    while (s.stream && s.next_frame < s.num_frames &&
+           s.next_frame >= s.next_write + s.window)
+      pthread_cond_wait (&s.written, &s.lock);
+    int k = s.next_frame++;
+    pthread_mutex_unlock (&s.lock);
+
+    if (k >= s.num_frames)
+      break;
+
+    if (s.swept)
+    {
+      prog.bind (s.param, s.value (k));
+      y_prog.bind (s.param, s.value (k));
+    }
+
+    if (!s.stream)
+    {
+      char fn[ 1024 ];
+      snprintf (fn, sizeof (fn), s.pattern.c_str(), k);
+
+      FILE *f = fopen (fn, "wb");
+      bool ok = f && stream_png (f, prog, y_prog, view, s.shader, s.colors,
+                                 1);
+      if (f && fclose (f) != 0)
+        ok = false;
+
+      if (!ok)
+      {
+        perror (fn);
+        pthread_mutex_lock (&s.lock);
+        s.failed++;
+        pthread_mutex_unlock (&s.lock);
+      }
+      continue;
+    }
+
+    levels.resize (view.width * view.height);
+    rgb.resize (view.width * view.height * 3);
+
+    Canvas c;
+    c.buf = &levels[0];
+    c.stride = view.width;
+    c.pixel_size = 1;
+
+    if (view_is_empty (prog, y_prog, view, 0, 0, view.width, view.height,
+                       s.shader))
+      fill (levels.begin(), levels.end(), 0);
+    else
+    {
+      render_implicit (prog, view, c, 0, 0, view.width, view.height,
+                       s.shader, PRECISION_AUTO, 1, &hoisted);
+      render_explicit (y_prog, view, c, 0, 0, view.width, view.height);
+    }
+
+    write_pixels (c, 0, 0, view.width, view.height, s.colors, PIXEL_RGB,
+                  &rgb[0], view.width * 3);
+    rgb_to_yuv420 (&rgb[0], view.width, view.height, yuv);
+
+    pthread_mutex_lock (&s.lock);
+    s.put (k, yuv);
+    pthread_mutex_unlock (&s.lock);
+  }
+
+  // whoever waits for a slot wakes up to find there are no frames left
+  pthread_mutex_lock (&s.lock);
+  pthread_cond_broadcast (&s.written);
+  pthread_mutex_unlock (&s.lock);
+
+  return NULL;
+}
+
+static bool
+ends_with (const string& s, const string& end)
+{
+  return s.size() >= end.size() &&
+         s.compare (s.size() - end.size(), end.size(), end) == 0;
+}
+
+// a name with one %d in it (%04d and the like too), and no other %
+static bool
+is_pattern (const string& s)
+{
+  int pos = s.find ('%');
+  if (pos == string::npos || s.find ('%', pos + 1) != string::npos)
+    return false;
+
+  int end = s.find_first_not_of ("0123456789", pos + 1);
+  return end != string::npos && s[ end ] == 'd';
+}
+
+int
+main (int argc, char **argv)
+{
+  View view (640, 480, 100.0, 0.0, 0.0);
+  double params[ NUM_PARAMS ] = { 0.0 };
+  param_set declared = NO_PARAMS;   // the equation may use only these
+  bool swept = false;
+  var_enum param = (var_enum) NUM_VARS;
+  double from = 0.0, to = 1.0;
+  int num_frames = 60, rate = 30;
+  int threads = default_num_threads();
+  shading_enum shading = SHADE_GAMMA;
+
+  int opt;
+  while ((opt = getopt (argc, argv, "w:h:s:x:y:p:a:n:r:j:d")) != -1)
+  {
+    switch (opt)
+    {
+      case 'w': view.width    = atoi (optarg); break;
+      case 'h': view.height   = atoi (optarg); break;
+      case 's': view.scale    = atof (optarg); break;
+      case 'x': view.center_x = atof (optarg); break;
+      case 'y': view.center_y = atof (optarg); break;
+      case 'p':
+        if (!parse_binding (optarg, params, declared))
+          usage();
+        break;
+      case 'a':
+        if (!parse_sweep (optarg, param, from, to))
+          usage();
+        declared |= param_bit (param);
+        swept = true;
+        break;
+      case 'n': num_frames = atoi (optarg); break;
+      case 'r': rate       = atoi (optarg); break;
+      case 'j': threads    = atoi (optarg); break;
+      case 'd': shading    = SHADE_DISTANCE; break;
+      default:  usage();
+    }
+  }
+
+  if (argc - optind != 2 || view.width <= 0 || view.height <= 0 ||
+      view.scale <= 0.0 || num_frames < 1 || rate < 1)
+    usage();
+
+  string text = argv[ optind ];
+  string out  = argv[ optind + 1 ];
+
+  bool y4m = (out == "-" || ends_with (out, ".y4m"));
+  if (!y4m && (!ends_with (out, ".png") || !is_pattern (out)))
+    usage();
+
+  // 4:2:0 has a chroma sample per 2x2 pixels
+  if (y4m && (view.width % 2 || view.height % 2))
+  {
+    fprintf (stderr, "a Y4M stream needs an even width and height\n");
+    return 1;
+  }
+
+  vector< Function > F, Y;
+  try
+  {
+    compile_equations (text, F, Y, declared);
+  }
+  catch (SyntaxException e)
+  {
+    fprintf (stderr, "syntax error at %d in \"%s\"\n", e.pos, text.c_str());
+    return 1;
+  }
+  catch (ArgumentException e)
+  {
+    fprintf (stderr, "bad argument at %d-%d in \"%s\"\n",
+             e.pos_start, e.pos_end, text.c_str());
+    return 1;
+  }
+
+  Sweep s;
+  s.shader = Shader (shading);
+  s.prog = compile_implicit (F, s.shader);
+  s.y_prog = Program (Y);
+  for (int p = 0; p < NUM_PARAMS; p++)
+  {
+    s.prog.bind ((var_enum) (NUM_VARS + p), params[p]);
+    s.y_prog.bind ((var_enum) (NUM_VARS + p), params[p]);
+  }
+
+  s.view = view;
+  s.swept = swept;
+  s.param = param;
+  s.from = from;
+  s.to = to;
+  s.num_frames = num_frames;
+  s.pattern = out;
+  s.stream = NULL;
+  s.next_frame = s.next_write = 0;
+  s.failed = 0;
+  pthread_mutex_init (&s.lock, NULL);
+  pthread_cond_init (&s.written, NULL);
+
+  threads = max (1, min (threads, num_frames));
+  s.window = AHEAD * threads;
+
+  if (y4m)
+  {
+    s.stream = (out == "-") ? stdout : fopen (out.c_str(), "wb");
+    if (!s.stream)
+    {
+      perror (out.c_str());
+      return 1;
+    }
+    fprintf (s.stream, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n",
+             view.width, view.height, rate);
+  }
+
+  struct timeval start, end;
+  gettimeofday (&start, NULL);
+
+  vector< pthread_t > tids (threads - 1);
+  int started = 0;
+  for (; started < threads - 1; started++)
+    if (pthread_create (&tids[ started ], NULL, worker, &s) != 0)
+      break;
+  worker (&s);
+  for (int i = 0; i < started; i++)
+    pthread_join (tids[i], NULL);
+
+  gettimeofday (&end, NULL);
+  double secs = (end.tv_sec - start.tv_sec) +
+                (end.tv_usec - start.tv_usec) * 1e-6;
+
+  if (s.stream && s.stream != stdout && fclose (s.stream) != 0)
+    s.failed++;
+  if (s.stream == stdout && fflush (stdout) != 0)
+    s.failed++;
+
+  // stdout may be the video
+  fprintf (stderr, "%d frames of %dx%d, %d threads, %.2f s: %.1f frames/s",
+           num_frames, view.width, view.height, started + 1, secs,
+           (secs > 0.0) ? num_frames / secs : 0.0);
+  if (s.failed)
+    fprintf (stderr, ", %d failed", s.failed);
+  fprintf (stderr, "\n");
+
+  pthread_cond_destroy (&s.written);
+  pthread_mutex_destroy (&s.lock);
+  return s.failed ? 1 : 0;
+}
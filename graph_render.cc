@@ -0,0 +1,198 @@
+/*
+ * graph_render: draws equations without the GUI.
+ *
+ *   graph_render [-w width] [-h height] [-s scale] [-x center_x]
+ *                [-y center_y] [-t] [-d] [-j threads] [-p name=value]...
+ *                equation output.{svg,pdf,png}
+ *
+ * -t traces the curves with Newton's method instead of marching squares.
+ * -p binds a parameter of the equation, e.g. -p a=2 for "y = a*x^2";
+ * the equation can use no parameter that isn't bound.
+ *
+ * PNGs are rendered like the GUI does, in bands that are compressed as
+ * they finish, so very large images need little memory. -d shades them
+ * by the distance to the curves, -j sets the threads (default: one per
+ * processor).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "func.h"
+#include "parse.h"
+#include "program.h"
+#include "eqtn.h"
+#include "view.h"
+#include "contour.h"
+#include "trace.h"
+#include "render.h"
+#include "shade.h"
+#include "pixels.h"
+#include "png_stream.h"
+
+using namespace std;
+using namespace Math;
+
+static void
+usage (void)
+{
+  fprintf (stderr,
+           "usage: graph_render [-w width] [-h height] [-s scale]\n"
+           "                    [-x center_x] [-y center_y] [-t] [-d]\n"
+           "                    [-j threads] [-p name=value]...\n"
+           "                    equation output.{svg,pdf,png}\n");
+  exit (1);
+}
+
+// "a=1.5" into params, and a into declared; false if it isn't a
+// parameter and a number
+static bool
+parse_binding (const char *arg, double *params, param_set& declared)
+{
+  const char *eq = strchr (arg, '=');
+  if (!eq)
+    return false;
+
+  string name (arg, eq - arg);
+  char *end;
+  double val = strtod (eq + 1, &end);
+  if (end == eq + 1 || *end != '\0')
+    return false;
+
+  for (int p = 0; p < NUM_PARAMS; p++)
+    if (name == var_names[ NUM_VARS + p ])
+    {
+      params[p] = val;
+      declared |= param_bit ((var_enum) (NUM_VARS + p));
+      return true;
+    }
+
+  return false;
+}
+
+static void
+bind_all (Program& prog, const double *params)
+{
+  for (int p = 0; p < NUM_PARAMS; p++)
+    prog.bind ((var_enum) (NUM_VARS + p), params[p]);
+}
+
+static string
+extension (const string& fn)
+{
+  int dot = fn.rfind ('.');
+  return (dot == string::npos) ? "" : fn.substr (dot + 1);
+}
+
+int
+main (int argc, char **argv)
+{
+  View view (800, 600, 100.0, 0.0, 0.0);
+  bool trace = false;
+  shading_enum shading = SHADE_GAMMA;
+  int threads = default_num_threads();
+  double params[ NUM_PARAMS ] = { 0.0 };
+  param_set declared = NO_PARAMS;   // the equation may use only these
+
+  int opt;
+  while ((opt = getopt (argc, argv, "w:h:s:x:y:tdj:p:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'w': view.width    = atoi (optarg); break;
+      case 'h': view.height   = atoi (optarg); break;
+      case 's': view.scale    = atof (optarg); break;
+      case 'x': view.center_x = atof (optarg); break;
+      case 'y': view.center_y = atof (optarg); break;
+      case 't': trace = true; break;
+      case 'd': shading = SHADE_DISTANCE; break;
+      case 'j': threads = atoi (optarg); break;
+      case 'p':
+        if (!parse_binding (optarg, params, declared))
+          usage();
+        break;
+      default:  usage();
+    }
+  }
+
+  if (argc - optind != 2 || view.width <= 0 || view.height <= 0 ||
+      view.scale <= 0.0)
+    usage();
+
+  string text = argv[ optind ];
+  string fn   = argv[ optind + 1 ];
+  string type = extension (fn);
+
+  if (type != "svg" && type != "pdf" && type != "png")
+    usage();
+
+  vector< Function > F, Y;
+  try
+  {
+    compile_equations (text, F, Y, declared);
+  }
+  catch (SyntaxException e)
+  {
+    fprintf (stderr, "syntax error at %d in \"%s\"\n", e.pos, text.c_str());
+    return 1;
+  }
+  catch (ArgumentException e)
+  {
+    fprintf (stderr, "bad argument at %d-%d in \"%s\"\n",
+             e.pos_start, e.pos_end, text.c_str());
+    return 1;
+  }
+
+  if (type == "png")
+  {
+    FILE *f = fopen (fn.c_str(), "wb");
+    if (!f)
+    {
+      perror (fn.c_str());
+      return 1;
+    }
+
+    Shader shader (shading);
+    Program prog = compile_implicit (F, shader);
+    Program y_prog (Y);
+    bind_all (prog, params);
+    bind_all (y_prog, params);
+
+    bool ok = stream_png (f, prog, y_prog, view, shader, Colormap(), threads);
+    if (fclose (f) != 0 || !ok)
+    {
+      fprintf (stderr, "error writing %s\n", fn.c_str());
+      return 1;
+    }
+    return 0;
+  }
+
+  for (int i = 0; i < Y.size(); i++)
+    F.push_back (implicit_form (Y[i]));
+
+  Program prog (F);
+  bind_all (prog, params);
+
+  vector< Polyline > lines =
+    trace ? trace_contours (F, view, 16, 1.0, params) :
+            extract_contours (prog, view);
+
+  FILE *f = fopen (fn.c_str(), "w");
+  if (!f)
+  {
+    perror (fn.c_str());
+    return 1;
+  }
+
+  if (type == "pdf")
+    write_pdf (f, view, lines);
+  else
+    write_svg (f, view, lines);
+
+  fclose (f);
+  return 0;
+}
@@ -0,0 +1,585 @@
+/*
+ * graph_server: renders equations to PNG on request, without the GUI.
+ *
+ *   graph_server [-s socket] [-j threads] [-f library.gfn]
+ *
+ * Listens on a Unix socket (default /tmp/grapher.sock). Each line a
+ * client sends is a request:
+ *
+ *   RENDER width height scale center_x center_y equation
+ *     answered by "PNG <bytes>\n" and the image, or "ERROR <why>\n"
+ *   STATS
+ *     answered by "STATS <bytes>\n" and the counters, one per line
+ *
+ * Requests for the same equation that are waiting at the same time are
+ * rendered as one batch, which compiles the equation once. Compiled
+ * equations and recently rendered images are kept, so repeated requests
+ * cost a lookup. graph_client sends requests and load-tests the server.
+ *
+ * -f maps a function file made by graph_compile: equations found in it
+ * are loaded already compiled instead of being parsed and differentiated.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <map>
+#include <algorithm>
+
+#include "func.h"
+#include "program.h"
+#include "eqtn.h"
+#include "view.h"
+#include "render.h"
+#include "shade.h"
+#include "pixels.h"
+#include "png_stream.h"
+#include "func_file.h"
+
+using namespace std;
+using namespace Math;
+
+#define DEFAULT_SOCKET "/tmp/grapher.sock"
+#define MAX_SIZE       4096               // pixels, each way
+#define MAX_LINE       8192
+#define MAX_PROGRAMS   64                 // compiled equations kept
+#define MAX_TILE_BYTES (64 * 1024 * 1024) // rendered images kept
+
+static double
+now (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// one RENDER, from the connection that sent it to a worker and back
+struct Request
+{
+  string equation;
+  View view;
+  string key;                       // the whole request, for the cache
+
+  vector< unsigned char > png;
+  string error;
+  bool done;
+  double received;
+  pthread_cond_t finished;
+};
+
+struct Compiled
+{
+  Program prog, y_prog;
+  string error;                     // why it did not compile, if it didn't
+  int users;                        // workers rendering with it right now
+};
+
+struct Stats
+{
+  double started;
+  long requests, errors, batches, batched;
+  long program_hits, program_misses, program_loads;
+  long tile_hits, tile_misses;
+  long bytes_out;
+  double latency_sum, latency_max;
+};
+
+// everything the threads share, under one lock
+struct Server
+{
+  pthread_mutex_t lock;
+  pthread_cond_t work;
+  deque< Request* > queue;
+
+  map< string, Compiled* > programs;
+  list< string > program_lru;       // most recently used first
+
+  map< string, vector< unsigned char > > tiles;
+  list< string > tile_lru;
+  long tile_bytes;
+
+  Shader shader;
+  Colormap colors;
+  Stats stats;
+
+  FunctionFile library;             // precompiled equations, read only
+};
+
+static Server server;
+
+// moves key to the front of lru
+static void
+touch (list< string >& lru, const string& key)
+{
+  lru.remove (key);
+  lru.push_front (key);
+}
+
+// equation from the library into c; false if it isn't there
+static bool
+load_program (const string& equation, Compiled *c)
+{
+  bool distance = server.shader.uses_distance();
+  FunctionEntry e;
+  int i = server.library.find (equation);
+  if (i < 0 || !server.library.get (i, e, distance))
+    return false;
+
+  // nothing binds parameters here; compiled from the text, it is the
+  // syntax error it would have been without the library
+  if (used_params (e.F) | used_params (e.Y))
+    return false;
+
+  // what compile_implicit() would make, without differentiating
+  if (distance && e.dF.size() == 2 * e.F.size())
+  {
+    vector< Function > funcs;
+    for (int k = 0; k < e.F.size(); k++)
+    {
+      funcs.push_back (e.F[k]);
+      funcs.push_back (e.dF[2*k]);
+      funcs.push_back (e.dF[2*k + 1]);
+    }
+    c->prog = Program (funcs);
+  }
+  else
+    c->prog = compile_implicit (e.F, server.shader);
+  c->y_prog = Program (e.Y);
+  return true;
+}
+
+// the compiled equation, compiling it if it is not cached; the caller
+// must release() it. Called without the lock.
+static Compiled *
+get_program (const string& equation)
+{
+  pthread_mutex_lock (&server.lock);
+  map< string, Compiled* >::iterator it = server.programs.find (equation);
+  if (it != server.programs.end())
+  {
+    Compiled *c = it->second;
+    c->users++;
+    touch (server.program_lru, equation);
+    server.stats.program_hits++;
+    pthread_mutex_unlock (&server.lock);
+    return c;
+  }
+  server.stats.program_misses++;
+  pthread_mutex_unlock (&server.lock);
+
+  // compiling takes a while; do it without holding everyone up
+  Compiled *c = new Compiled;
+  c->users = 1;
+  bool loaded = load_program (equation, c);
+  try
+  {
+    if (!loaded)
+    {
+      string text = equation;
+      vector< Function > F, Y;
+      compile_equations (text, F, Y);
+      c->prog = compile_implicit (F, server.shader);
+      c->y_prog = Program (Y);
+    }
+  }
+  catch (SyntaxException e)
+  {
+    char buf[ 64 ];
+    sprintf (buf, "syntax error at %d", e.pos);
+    c->error = buf;
+  }
+  catch (ArgumentException e)
+  {
+    char buf[ 64 ];
+    sprintf (buf, "bad argument at %d-%d", e.pos_start, e.pos_end);
+    c->error = buf;
+  }
+
+  pthread_mutex_lock (&server.lock);
+  if (loaded)
+    server.stats.program_loads++;
+
+  // another worker may have compiled it meanwhile, and be using it
+  it = server.programs.find (equation);
+  if (it != server.programs.end())
+  {
+    delete c;
+    c = it->second;
+    c->users++;
+  }
+  else
+    server.programs[ equation ] = c;
+  touch (server.program_lru, equation);
+
+  // forget the least recently used ones nobody is using
+  list< string >::iterator old = server.program_lru.end();
+  while (server.programs.size() > MAX_PROGRAMS &&
+         old != server.program_lru.begin())
+  {
+    --old;
+    Compiled *o = server.programs[ *old ];
+    if (o->users == 0)
+    {
+      delete o;
+      server.programs.erase (*old);
+      old = server.program_lru.erase (old);
+    }
+  }
+  pthread_mutex_unlock (&server.lock);
+
+  return c;
+}
+
+static void
+release (Compiled *c)
+{
+  pthread_mutex_lock (&server.lock);
+  c->users--;
+  pthread_mutex_unlock (&server.lock);
+}
+
+// the cached image for r, if there is one; called with the lock
+static bool
+find_tile (Request *r)
+{
+  map< string, vector< unsigned char > >::iterator it =
+    server.tiles.find (r->key);
+  if (it == server.tiles.end())
+    return false;
+
+  r->png = it->second;
+  touch (server.tile_lru, r->key);
+  return true;
+}
+
+// called with the lock
+static void
+add_tile (Request *r)
+{
+  if (server.tiles.count (r->key) || r->png.size() > MAX_TILE_BYTES / 4)
+    return;
+
+  server.tiles[ r->key ] = r->png;
+  server.tile_lru.push_front (r->key);
+  server.tile_bytes += r->png.size();
+
+  while (server.tile_bytes > MAX_TILE_BYTES)
+  {
+    string& oldest = server.tile_lru.back();
+    server.tile_bytes -= server.tiles[ oldest ].size();
+    server.tiles.erase (oldest);
+    server.tile_lru.pop_back();
+  }
+}
+
+static void *
+worker (void *)
+{
+  for (;;)
+  {
+    pthread_mutex_lock (&server.lock);
+    while (server.queue.empty())
+      pthread_cond_wait (&server.work, &server.lock);
+
+    // this request, and every other one waiting with the same equation
+    vector< Request* > batch;
+    batch.push_back (server.queue.front());
+    server.queue.pop_front();
+    for (deque< Request* >::iterator it = server.queue.begin();
+         it != server.queue.end();)
+      if ((*it)->equation == batch[0]->equation)
+      {
+        batch.push_back (*it);
+        it = server.queue.erase (it);
+      }
+      else
+        ++it;
+
+    server.stats.batches++;
+    server.stats.batched += batch.size() - 1;
+    pthread_mutex_unlock (&server.lock);
+
+    Compiled *c = NULL;
+    for (int i = 0; i < batch.size(); i++)
+    {
+      Request *r = batch[i];
+
+      pthread_mutex_lock (&server.lock);
+      bool cached = find_tile (r);
+      if (cached)
+        server.stats.tile_hits++;
+      else
+        server.stats.tile_misses++;
+      pthread_mutex_unlock (&server.lock);
+
+      if (!cached)
+      {
+        if (!c)
+          c = get_program (r->equation);
+
+        if (!c->error.empty())
+          r->error = c->error;
+        else if (!stream_png (r->png, c->prog, c->y_prog, r->view,
+                              server.shader, server.colors, 1))
+          r->error = "could not encode the image";
+      }
+
+      pthread_mutex_lock (&server.lock);
+      if (!cached && r->error.empty())
+        add_tile (r);
+
+      double latency = now() - r->received;
+      server.stats.latency_sum += latency;
+      server.stats.latency_max = max (server.stats.latency_max, latency);
+      if (!r->error.empty())
+        server.stats.errors++;
+
+      r->done = true;
+      pthread_cond_signal (&r->finished);
+      pthread_mutex_unlock (&server.lock);
+    }
+
+    if (c)
+      release (c);
+  }
+
+  return NULL;
+}
+
+static bool
+write_all (int fd, const void *data, size_t size)
+{
+  const char *p = (const char*) data;
+  while (size > 0)
+  {
+    ssize_t n = write (fd, p, size);
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+// the answer to STATS
+static string
+format_stats (void)
+{
+  pthread_mutex_lock (&server.lock);
+  Stats s = server.stats;
+  int programs = server.programs.size();
+  int tiles = server.tiles.size();
+  long tile_bytes = server.tile_bytes;
+  pthread_mutex_unlock (&server.lock);
+
+  double uptime = now() - s.started;
+  long served = s.tile_hits + s.tile_misses;
+
+  char buf[ 1024 ];
+  sprintf (buf,
+           "uptime %.1f\n"
+           "requests %ld\n"
+           "errors %ld\n"
+           "requests_per_second %.2f\n"
+           "batches %ld\n"
+           "batched_requests %ld\n"
+           "program_hits %ld\n"
+           "program_misses %ld\n"
+           "program_loads %ld\n"
+           "programs_cached %d\n"
+           "tile_hits %ld\n"
+           "tile_misses %ld\n"
+           "tiles_cached %d\n"
+           "tile_cache_bytes %ld\n"
+           "latency_mean_ms %.3f\n"
+           "latency_max_ms %.3f\n"
+           "bytes_out %ld\n",
+           uptime, s.requests, s.errors,
+           uptime > 0 ? s.requests / uptime : 0.0,
+           s.batches, s.batched,
+           s.program_hits, s.program_misses, s.program_loads, programs,
+           s.tile_hits, s.tile_misses, tiles, tile_bytes,
+           served ? s.latency_sum / served * 1e3 : 0.0,
+           s.latency_max * 1e3, s.bytes_out);
+  return buf;
+}
+
+static void *
+connection (void *arg)
+{
+  int fd = (int)(long) arg;
+  FILE *in = fdopen (fd, "r");
+  if (!in)
+  {
+    close (fd);
+    return NULL;
+  }
+
+  char line[ MAX_LINE ];
+  while (fgets (line, sizeof (line), in))
+  {
+    line[ strcspn (line, "\r\n") ] = '\0';
+
+    if (strcmp (line, "STATS") == 0)
+    {
+      string s = format_stats();
+      char head[ 32 ];
+      sprintf (head, "STATS %d\n", (int) s.size());
+      if (!write_all (fd, head, strlen (head)) ||
+          !write_all (fd, s.data(), s.size()))
+        break;
+      continue;
+    }
+
+    Request r;
+    int eq = 0;
+    if (sscanf (line, "RENDER %d %d %lf %lf %lf %n",
+                &r.view.width, &r.view.height, &r.view.scale,
+                &r.view.center_x, &r.view.center_y, &eq) < 5 || eq == 0 ||
+        r.view.width <= 0 || r.view.height <= 0 ||
+        r.view.width > MAX_SIZE || r.view.height > MAX_SIZE ||
+        !(r.view.scale > 0.0))
+    {
+      const char *err = "ERROR bad request\n";
+      if (!write_all (fd, err, strlen (err)))
+        break;
+      continue;
+    }
+
+    r.equation = line + eq;
+    r.key = line;
+    r.done = false;
+    r.received = now();
+    pthread_cond_init (&r.finished, NULL);
+
+    pthread_mutex_lock (&server.lock);
+    server.stats.requests++;
+    server.queue.push_back (&r);
+    pthread_cond_signal (&server.work);
+    while (!r.done)
+      pthread_cond_wait (&r.finished, &server.lock);
+    pthread_mutex_unlock (&server.lock);
+    pthread_cond_destroy (&r.finished);
+
+    char head[ 300 ];
+    if (!r.error.empty())
+      sprintf (head, "ERROR %.200s\n", r.error.c_str());
+    else
+      sprintf (head, "PNG %d\n", (int) r.png.size());
+
+    // an error has no body
+    if (!write_all (fd, head, strlen (head)) ||
+        (!r.png.empty() && !write_all (fd, &r.png[0], r.png.size())))
+      break;
+
+    pthread_mutex_lock (&server.lock);
+    server.stats.bytes_out += r.png.size();
+    pthread_mutex_unlock (&server.lock);
+  }
+
+  fclose (in);
+  return NULL;
+}
+
+static void
+usage (void)
+{
+  fprintf (stderr, "usage: graph_server [-s socket] [-j threads] "
+                   "[-f library.gfn]\n");
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  string path = DEFAULT_SOCKET;
+  int threads = default_num_threads();
+
+  int opt;
+  while ((opt = getopt (argc, argv, "s:j:f:")) != -1)
+  {
+    switch (opt)
+    {
+      case 's': path    = optarg; break;
+      case 'j': threads = atoi (optarg); break;
+      case 'f':
+        if (!server.library.open (optarg))
+        {
+          fprintf (stderr, "%s: %s\n", optarg,
+                   server.library.get_error().c_str());
+          return 1;
+        }
+        break;
+      default:  usage();
+    }
+  }
+  if (optind != argc || threads <= 0)
+    usage();
+
+  signal (SIGPIPE, SIG_IGN);   // clients that hang up are noticed by write
+
+  pthread_mutex_init (&server.lock, NULL);
+  pthread_cond_init (&server.work, NULL);
+  server.tile_bytes = 0;
+  memset (&server.stats, 0, sizeof (server.stats));
+  server.stats.started = now();
+
+  int sock = socket (AF_UNIX, SOCK_STREAM, 0);
+  struct sockaddr_un addr;
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof (addr.sun_path))
+  {
+    fprintf (stderr, "socket path too long: %s\n", path.c_str());
+    return 1;
+  }
+  strcpy (addr.sun_path, path.c_str());
+  unlink (path.c_str());
+
+  if (sock < 0 || bind (sock, (struct sockaddr*) &addr, sizeof (addr)) != 0 ||
+      listen (sock, 64) != 0)
+  {
+    perror (path.c_str());
+    return 1;
+  }
+
+  for (int i = 0; i < threads; i++)
+  {
+    pthread_t tid;
+    if (pthread_create (&tid, NULL, worker, NULL) != 0)
+    {
+      perror ("pthread_create");
+      return 1;
+    }
+  }
+
+  printf ("listening on %s with %d threads\n", path.c_str(), threads);
+  fflush (stdout);
+
+  for (;;)
+  {
+    int fd = accept (sock, NULL, NULL);
+    if (fd < 0)
+      continue;
+
+    pthread_t tid;
+    pthread_attr_t attr;
+    pthread_attr_init (&attr);
+    pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create (&tid, &attr, connection, (void*)(long) fd) != 0)
+      close (fd);
+    pthread_attr_destroy (&attr);
+  }
+
+  return 0;
+}
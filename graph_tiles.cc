@@ -0,0 +1,279 @@
+/*
+ * graph_tiles: draws equations into a tile pyramid for web map viewers.
+ *
+ *   graph_tiles [-e x_min,x_max,y_min,y_max] [-z min_zoom] [-Z max_zoom]
+ *               [-j threads] [-d] equation directory
+ *
+ * Zoom level z covers the extent, made square around its center, with
+ * 2^z by 2^z tiles of 256x256 pixels, written as directory/z/x/y.png with
+ * y growing downwards: the usual "slippy map" layout.
+ *
+ * Tiles that already exist are left alone, so an interrupted run carries
+ * on where it stopped. Tiles that interval bounds prove empty, and all
+ * the tiles under them, are not written at all; viewers show their
+ * background for missing tiles. -d shades by the distance to the curves,
+ * which turns that test off.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "func.h"
+#include "program.h"
+#include "eqtn.h"
+#include "view.h"
+#include "render.h"
+#include "shade.h"
+#include "pixels.h"
+#include "png_stream.h"
+
+using namespace std;
+using namespace Math;
+
+#define TILE_PX    256
+#define MAX_ZOOM   22   // 256 * 2^22 pixels still fit in an int
+#define SPLIT_ZOOM 3    // each tile of this level is a job with everything
+                        // under it; the levels above are a job per tile
+
+static void
+usage (void)
+{
+  fprintf (stderr,
+           "usage: graph_tiles [-e x_min,x_max,y_min,y_max] [-z min_zoom]\n"
+           "                   [-Z max_zoom] [-j threads] [-d]\n"
+           "                   equation directory\n");
+  exit (1);
+}
+
+struct Job
+{
+  int z, x, y;
+  bool subtree;
+};
+
+struct Pyramid
+{
+  Program prog, y_prog;
+  Shader shader;
+  Colormap colors;
+
+  double center_x, center_y, size;
+  int max_zoom;
+  string dir;
+
+  vector< Job > jobs;
+  int next_job;
+  int rendered, existing, empty, failed;
+  pthread_mutex_t lock;
+
+  View zoom_view (int z) const;
+  void tile (int z, int x, int y, bool subtree);
+  void count (int& counter);
+};
+
+// all the tiles of zoom level z as one view; a tile is a rectangle of it,
+// so neighbouring tiles meet exactly however deep the zoom
+View
+Pyramid::zoom_view (int z) const
+{
+  int px = TILE_PX << z;
+  return View (px, px, px / size, center_x, center_y);
+}
+
+void
+Pyramid::count (int& counter)
+{
+  pthread_mutex_lock (&lock);
+  counter++;
+  pthread_mutex_unlock (&lock);
+}
+
+static void
+make_dir (const string& path)
+{
+  if (mkdir (path.c_str(), 0777) != 0 && errno != EEXIST)
+    perror (path.c_str());
+}
+
+static string
+itos (int i)
+{
+  char buf[ 16 ];
+  sprintf (buf, "%d", i);
+  return buf;
+}
+
+void
+Pyramid::tile (int z, int x, int y, bool subtree)
+{
+  View view = zoom_view (z);
+  int px_x = x * TILE_PX, px_y = y * TILE_PX;
+
+  // nothing in here can show up on a tile under this one either
+  if (view_is_empty (prog, y_prog, view, px_x, px_y, TILE_PX, TILE_PX,
+                     shader))
+  {
+    count (empty);
+    return;
+  }
+
+  string path = dir + "/" + itos (z) + "/" + itos (x);
+  string fn   = path + "/" + itos (y) + ".png";
+
+  struct stat st;
+  if (stat (fn.c_str(), &st) == 0)
+    count (existing);
+  else
+  {
+    make_dir (dir + "/" + itos (z));
+    make_dir (path);
+
+    // written under another name first, so that a tile that exists is
+    // always complete
+    string tmp = fn + ".tmp";
+    FILE *f = fopen (tmp.c_str(), "wb");
+    bool ok = f && stream_png (f, prog, y_prog, view,
+                               px_x, px_y, TILE_PX, TILE_PX,
+                               shader, colors, 1);
+    if (f && fclose (f) != 0)
+      ok = false;
+
+    if (ok && rename (tmp.c_str(), fn.c_str()) == 0)
+      count (rendered);
+    else
+    {
+      perror (fn.c_str());
+      unlink (tmp.c_str());
+      count (failed);
+    }
+  }
+
+  if (subtree && z < max_zoom)
+    for (int k = 0; k < 4; k++)
+      tile (z + 1, 2*x + (k & 1), 2*y + (k >> 1), true);
+}
+
+static void *
+worker (void *p)
+{
+  Pyramid& pyr = *(Pyramid*) p;
+  for (;;)
+  {
+    pthread_mutex_lock (&pyr.lock);
+    int j = pyr.next_job++;
+    pthread_mutex_unlock (&pyr.lock);
+
+    if (j >= pyr.jobs.size())
+      break;
+
+    const Job& job = pyr.jobs[j];
+    pyr.tile (job.z, job.x, job.y, job.subtree);
+  }
+  return NULL;
+}
+
+int
+main (int argc, char **argv)
+{
+  double x_min = -10.0, x_max = 10.0, y_min = -10.0, y_max = 10.0;
+  int min_zoom = 0, max_zoom = 5;
+  int threads = default_num_threads();
+  shading_enum shading = SHADE_GAMMA;
+
+  int opt;
+  while ((opt = getopt (argc, argv, "e:z:Z:j:d")) != -1)
+  {
+    switch (opt)
+    {
+      case 'e':
+        if (sscanf (optarg, "%lf,%lf,%lf,%lf",
+                    &x_min, &x_max, &y_min, &y_max) != 4)
+          usage();
+        break;
+      case 'z': min_zoom = atoi (optarg); break;
+      case 'Z': max_zoom = atoi (optarg); break;
+      case 'j': threads  = atoi (optarg); break;
+      case 'd': shading  = SHADE_DISTANCE; break;
+      default:  usage();
+    }
+  }
+
+  if (argc - optind != 2 || x_max <= x_min || y_max <= y_min ||
+      min_zoom < 0 || max_zoom < min_zoom || max_zoom > MAX_ZOOM)
+    usage();
+
+  string text = argv[ optind ];
+
+  vector< Function > F, Y;
+  try
+  {
+    compile_equations (text, F, Y);
+  }
+  catch (SyntaxException e)
+  {
+    fprintf (stderr, "syntax error at %d in \"%s\"\n", e.pos, text.c_str());
+    return 1;
+  }
+  catch (ArgumentException e)
+  {
+    fprintf (stderr, "bad argument at %d-%d in \"%s\"\n",
+             e.pos_start, e.pos_end, text.c_str());
+    return 1;
+  }
+
+  Pyramid pyr;
+  pyr.shader = Shader (shading);
+  pyr.prog = compile_implicit (F, pyr.shader);
+  pyr.y_prog = Program (Y);
+  pyr.center_x = (x_min + x_max) / 2;
+  pyr.center_y = (y_min + y_max) / 2;
+  pyr.size = max (x_max - x_min, y_max - y_min);
+  pyr.max_zoom = max_zoom;
+  pyr.dir = argv[ optind + 1 ];
+  pyr.next_job = 0;
+  pyr.rendered = pyr.existing = pyr.empty = pyr.failed = 0;
+  pthread_mutex_init (&pyr.lock, NULL);
+
+  make_dir (pyr.dir);
+
+  int split = max (min_zoom, min (SPLIT_ZOOM, max_zoom));
+  for (int z = min_zoom; z <= split; z++)
+    for (int x = 0; x < (1 << z); x++)
+      for (int y = 0; y < (1 << z); y++)
+      {
+        Job job = { z, x, y, z == split };
+        pyr.jobs.push_back (job);
+      }
+
+  struct timeval start, end;
+  gettimeofday (&start, NULL);
+
+  threads = max (1, threads);
+  vector< pthread_t > tids (threads - 1);
+  int started = 0;
+  for (; started < threads - 1; started++)
+    if (pthread_create (&tids[ started ], NULL, worker, &pyr) != 0)
+      break;
+  worker (&pyr);
+  for (int i = 0; i < started; i++)
+    pthread_join (tids[i], NULL);
+
+  gettimeofday (&end, NULL);
+  double secs = (end.tv_sec - start.tv_sec) +
+                (end.tv_usec - start.tv_usec) * 1e-6;
+
+  printf ("%d tiles rendered, %d already there, %d empty subtrees skipped,"
+          " %d failed, %.2f s\n",
+          pyr.rendered, pyr.existing, pyr.empty, pyr.failed, secs);
+
+  pthread_mutex_destroy (&pyr.lock);
+  return pyr.failed ? 1 : 0;
+}
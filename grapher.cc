@@ -10,10 +10,17 @@
 #include <math.h>
 #include <stdlib.h>
 #include <list>
+#include <vector>
+#include <algorithm>
 #include <assert.h>
 
 #include "func.h"
+#include "parse.h"
+#include "eqtn.h"
 #include "graph_area.h"
+#include "render.h"
+#include "func_file.h"
+#include "session.h"
 
 using namespace std;
 using namespace Math;
@@ -25,6 +32,10 @@ typedef Glib::RefPtr< Gdk::Pixbuf > pixbufptr;
 #define DEFAULT_SCALE      100.0
 #define DEFAULT_SCALE_STR "100.0"
 
+#define ANIM_FPS   30
+#define ANIM_BACKGROUND_FPS 5   // while another window has the focus
+#define ANIM_SWEEP 4.0    // seconds from one end of the range to the other
+
 struct win_info
 {
   win_info (void)
@@ -35,6 +46,7 @@ struct win_info
 
   ~win_info (void)
   {
+    anim_timer.disconnect();
     delete filesel;
     delete graph_area;
   }
@@ -44,13 +56,35 @@ struct win_info
   Gtk::ToggleButton *draw_grid_btn;
   GraphArea  *graph_area;
   Gtk::MenuItem *new_window, *save_as, *quit, *about;
+  Gtk::CheckMenuItem *fast_eval, *perf_overlay, *save_images;
+  Gtk::RadioMenuItem *shade_gamma, *shade_linear, *shade_distance;
   Gtk::Ruler *hruler, *vruler;
+  Gtk::Entry *param_entry, *param_from_entry, *param_to_entry;
+  Gtk::HScale *param_scale;
+  Gtk::ToggleButton *animate_btn;
+  Gtk::Label *anim_label;
   
   Gtk::FileSelection *filesel;
+
+  // the text the graph was compiled from, empty if there is no graph
+  string shown_eqtn;
+
+  // the running animation: the timer driving it, and the frames drawn
+  // since the stats were last shown
+  SigC::Connection anim_timer;
+  double anim_started, anim_shown;
+  int anim_frames;
+  double anim_total, anim_worst;   // frame times, in seconds
 };
 
 list< win_info* > g_windows;
 
+// where the session is saved, and the equations it was last saved with,
+// which are looked up before anything is parsed
+static string g_session_dir;
+static FunctionFile g_library;
+static bool g_save_images = false;
+
 // window
 static bool on_graph_window_delete  (GdkEventAny* any, win_info* wi);
 
@@ -60,6 +94,7 @@ static void on_save_as_activate     (win_info *wi);
 static void on_save_ok_clicked      (win_info *wi);
 static void on_quit_activate        (win_info *wi);
 static void on_about_activate       (win_info *wi);
+static void on_save_images_toggled  (win_info *wi);
 
 // entries
 static void eqtn_changed            (win_info *wi);
@@ -67,12 +102,32 @@ static void modify_graph_params     (win_info *wi);
 
 // other
 static void on_draw_grid_btn_toggled     (win_info *wi);
+static void on_fast_eval_toggled         (win_info *wi);
+static void on_perf_overlay_toggled      (win_info *wi);
+static void on_shading_toggled           (win_info *wi);
+static void on_param_changed             (win_info *wi);
+static void on_param_range_changed       (win_info *wi);
+static void on_param_scale_changed       (win_info *wi);
+static void on_animate_btn_toggled       (win_info *wi);
+static bool on_animate_tick              (win_info *wi);
 static bool on_graph_area_motion_notify  (GdkEventMotion *ev, win_info *wi);
+static bool on_graph_window_state        (GdkEventWindowState *ev,
+                                          win_info *wi);
+static bool on_graph_window_focus_in     (GdkEventFocus *ev, win_info *wi);
+static bool on_graph_window_focus_out    (GdkEventFocus *ev, win_info *wi);
+
+static void start_anim_timer (win_info *wi);
 
 static void set_rulers (win_info *wi, int x = -1, int y = -1);
 
+// sessions
+static WindowState get_window_state   (win_info *wi, bool with_image);
+static void        apply_window_state (win_info *wi, const WindowState& s);
+static void        save_current_session (void);
+
+// a new window, as state says if it is given
 static win_info*
-create_new_window (void)
+create_new_window (const WindowState *state = NULL)
 {
   win_info *wi = NULL;
   
@@ -100,8 +155,20 @@ create_new_window (void)
   new_win->get_widget ("save_as", wi->save_as);
   new_win->get_widget ("quit", wi->quit);
   new_win->get_widget ("about", wi->about);
+  new_win->get_widget ("fast_eval", wi->fast_eval);
+  new_win->get_widget ("perf_overlay", wi->perf_overlay);
+  new_win->get_widget ("save_images", wi->save_images);
+  new_win->get_widget ("shade_gamma", wi->shade_gamma);
+  new_win->get_widget ("shade_linear", wi->shade_linear);
+  new_win->get_widget ("shade_distance", wi->shade_distance);
   new_win->get_widget ("hruler", wi->hruler);
   new_win->get_widget ("vruler", wi->vruler);
+  new_win->get_widget ("param_entry", wi->param_entry);
+  new_win->get_widget ("param_from_entry", wi->param_from_entry);
+  new_win->get_widget ("param_to_entry", wi->param_to_entry);
+  new_win->get_widget ("param_scale", wi->param_scale);
+  new_win->get_widget ("animate_btn", wi->animate_btn);
+  new_win->get_widget ("anim_label", wi->anim_label);
   
 
   wi->graph_area = new GraphArea(75);
@@ -112,6 +179,12 @@ create_new_window (void)
   // window signals
   wi->graph_window->signal_delete_event().connect (SigC::bind< win_info* > 
     (SigC::slot (on_graph_window_delete), wi));
+  wi->graph_window->signal_window_state_event().connect (
+    SigC::bind< win_info* > (SigC::slot (on_graph_window_state), wi));
+  wi->graph_window->signal_focus_in_event().connect (
+    SigC::bind< win_info* > (SigC::slot (on_graph_window_focus_in), wi));
+  wi->graph_window->signal_focus_out_event().connect (
+    SigC::bind< win_info* > (SigC::slot (on_graph_window_focus_out), wi));
   
   // graph_area signals
   wi->graph_area->signal_motion_notify_event().connect (SigC::bind< win_info* >
@@ -131,6 +204,18 @@ create_new_window (void)
   // toggle grid signal
   wi->draw_grid_btn->signal_toggled().connect (SigC::bind< win_info* > 
     (SigC::slot (on_draw_grid_btn_toggled), wi));
+
+  // parameter signals
+  wi->param_entry->signal_activate().connect (SigC::bind< win_info* > 
+    (SigC::slot (on_param_changed), wi));
+  wi->param_from_entry->signal_activate().connect (SigC::bind< win_info* > 
+    (SigC::slot (on_param_range_changed), wi));
+  wi->param_to_entry->signal_activate().connect (SigC::bind< win_info* > 
+    (SigC::slot (on_param_range_changed), wi));
+  wi->param_scale->signal_value_changed().connect (SigC::bind< win_info* > 
+    (SigC::slot (on_param_scale_changed), wi));
+  wi->animate_btn->signal_toggled().connect (SigC::bind< win_info* > 
+    (SigC::slot (on_animate_btn_toggled), wi));
       
   // menu signals
   wi->new_window->signal_activate().connect (SigC::bind< win_info* > 
@@ -141,6 +226,18 @@ create_new_window (void)
     (SigC::slot (on_quit_activate), wi));
   wi->about->signal_activate().connect (SigC::bind< win_info* > 
     (SigC::slot (on_about_activate), wi));
+  wi->fast_eval->signal_toggled().connect (SigC::bind< win_info* > 
+    (SigC::slot (on_fast_eval_toggled), wi));
+  wi->perf_overlay->signal_toggled().connect (SigC::bind< win_info* > 
+    (SigC::slot (on_perf_overlay_toggled), wi));
+  wi->save_images->signal_toggled().connect (SigC::bind< win_info* > 
+    (SigC::slot (on_save_images_toggled), wi));
+  wi->shade_gamma->signal_toggled().connect (SigC::bind< win_info* > 
+    (SigC::slot (on_shading_toggled), wi));
+  wi->shade_linear->signal_toggled().connect (SigC::bind< win_info* > 
+    (SigC::slot (on_shading_toggled), wi));
+  wi->shade_distance->signal_toggled().connect (SigC::bind< win_info* > 
+    (SigC::slot (on_shading_toggled), wi));
 
   // file selection signals
   wi->filesel->get_ok_button()->signal_clicked().connect (SigC::bind<win_info*>
@@ -159,10 +256,21 @@ create_new_window (void)
   
   // disable the save_as, there is no function yet
   wi->save_as->set_sensitive (false);
+
+  // and the parameter, until an equation has one
+  wi->param_scale->set_sensitive (false);
+  wi->animate_btn->set_sensitive (false);
   
   // set file selection defaults
   wi->filesel->set_transient_for (*wi->graph_window);
   wi->filesel->set_filename ("graph.png");
+
+  wi->save_images->set_active (g_save_images);
+
+  // before the window is shown, so it comes up at its size and with its
+  // image, and nothing is drawn twice
+  if (state)
+    apply_window_state (wi, *state);
   
   g_windows.push_back (wi);
 
@@ -176,7 +284,18 @@ main (int argc, char **argv)
 {
   Gtk::Main app(argc, argv);
 
-  if (!create_new_window())
+  // grapher [session_dir]
+  g_session_dir = (argc > 1) ? argv[1] : default_session_dir();
+
+  Session session;
+  if (load_session (g_session_dir, session, g_library))
+  {
+    g_save_images = session.save_images;
+    for (int i = 0; i < session.windows.size(); i++)
+      create_new_window (&session.windows[i]);
+  }
+
+  if (g_windows.empty() && !create_new_window())
     return -1;
   
   app.run();
@@ -187,20 +306,10 @@ main (int argc, char **argv)
 static void 
 on_new_window_activate (win_info* wi)
 {
-  win_info *new_wi = create_new_window();
-  if (new_wi)
-  {
-    // copy the window state
-    new_wi->eqtn_entry->set_text (wi->eqtn_entry->get_text());
-    new_wi->scale_entry->set_text (wi->scale_entry->get_text());
-    new_wi->center_x_entry->set_text (wi->center_x_entry->get_text());
-    new_wi->center_y_entry->set_text (wi->center_y_entry->get_text());
-    new_wi->draw_grid_btn->set_sensitive (wi->draw_grid_btn->sensitive());
-    new_wi->draw_grid_btn->set_active (wi->draw_grid_btn->get_active());  
-    new_wi->save_as->set_sensitive (wi->save_as->sensitive());
-
-    *(new_wi->graph_area) = *(wi->graph_area);
-  }
+  // a copy, image and all, so nothing is drawn until something changes
+  WindowState state = get_window_state (wi, true);
+  state.x = state.y = -1;   // wherever the window manager puts it
+  create_new_window (&state);
 }
 
 static void 
@@ -212,13 +321,23 @@ on_save_as_activate (win_info* wi)
 static void
 on_save_ok_clicked (win_info *wi)
 {
-  wi->graph_area->save_img (wi->filesel->get_filename(), "png", wi->graph_area->has_grid());
+  string fn = wi->filesel->get_filename();
+  string ext = (fn.rfind ('.') == string::npos) ? "" :
+                 fn.substr (fn.rfind ('.') + 1);
+
+  if (ext == "svg" || ext == "pdf")
+    wi->graph_area->save_vector (fn, ext);
+  else if (ext == "csv" || ext == "json")
+    wi->graph_area->save_perf (fn, ext);
+  else
+    wi->graph_area->save_img (fn, "png", wi->graph_area->has_grid());
   wi->filesel->hide();
 }
 
 static void
 on_quit_activate (win_info* wi)
 {
+  save_current_session();
   exit (0);
 }
 
@@ -228,50 +347,213 @@ on_about_activate (win_info* wi)
   printf ("Grapher 0.1 - Yury Sulsky <yury@nyu.edu>\n");
 }
 
+static void
+on_save_images_toggled (win_info* wi)
+{
+  // one setting for the whole session, which every window's menu shows
+  g_save_images = wi->save_images->get_active();
+  list< win_info* >::iterator it;
+  for (it = g_windows.begin(); it != g_windows.end(); it++)
+    if ((*it)->save_images->get_active() != g_save_images)
+      (*it)->save_images->set_active (g_save_images);
+}
+
 static void
 on_draw_grid_btn_toggled (win_info* wi)
 {
   wi->graph_area->toggle_grid();
 }
 
-void
-GraphArea::draw_graph (int x, int y, int width, int height)
+static void
+on_fast_eval_toggled (win_info* wi)
 {
-  int half_width  = img->get_width() / 2;
-  int half_height = img->get_height() / 2;
-  
-  guchar* buf = img->get_pixels();
-  int stride  = img->get_rowstride();
-  int pixel_size = img->get_n_channels() *
-                   img->get_bits_per_sample() / 8;
+  wi->graph_area->set_precision (wi->fast_eval->get_active() ?
+                                 PRECISION_AUTO : PRECISION_DOUBLE);
+}
 
-  Glib::Timer timer;
+static void
+on_perf_overlay_toggled (win_info* wi)
+{
+  if (wi->perf_overlay->get_active() != wi->graph_area->has_hud())
+    wi->graph_area->toggle_hud();
+}
 
-  double x_y[2];
-  
-  for (int i = x; i < x + width; i++ )
-  {
-    for (int j = y; j < y + height; j++ )
+static void
+on_shading_toggled (win_info* wi)
+{
+  // both the item turned off and the one turned on get here
+  if (wi->shade_distance->get_active())
+    wi->graph_area->set_shading (SHADE_DISTANCE);
+  else if (wi->shade_linear->get_active())
+    wi->graph_area->set_shading (SHADE_LINEAR);
+  else if (wi->shade_gamma->get_active())
+    wi->graph_area->set_shading (SHADE_GAMMA);
+}
+
+// the parameter named by text, if it is one
+static bool
+find_param (const string& text, var_enum& param)
+{
+  for (int v = NUM_VARS; v < NUM_VALUES; v++)
+    if (text == var_names[v])
     {
-      x_y[0] = ((double) (i - half_width))  / scale + center_x;
-      x_y[1] = ((double)-(j - half_height)) / scale - center_y;
-      
-      int bytepos = j*stride + i*pixel_size;
-      double diff = fabs (F (x_y));
-
-      if( diff < 1.0 )
-      {
-        // steepen the error curve
-        diff = ::pow (diff, 0.3f); // not float std::pow (float, float)
-        buf[ bytepos ] = (guchar) ((1.0f-diff) * 0xFF);
-      }
-      else
-        buf[ bytepos ] = 0;
+      param = (var_enum) v;
+      return true;
     }
+
+  return false;
+}
+
+// the slider follows the parameter chosen
+static void
+on_param_changed (win_info* wi)
+{
+  var_enum param;
+  if (!find_param (wi->param_entry->get_text(), param))
+    return;
+
+  double val = wi->graph_area->get_param (param);
+  if (val == wi->param_scale->get_value())
+    return;
+
+  // a value outside the range the range takes in
+  double from = atof (wi->param_from_entry->get_text().c_str());
+  double to   = atof (wi->param_to_entry->get_text().c_str());
+  if (val < min (from, to) || val > max (from, to))
+    wi->param_scale->set_range (min (min (from, to), val),
+                                max (max (from, to), val));
+  wi->param_scale->set_value (val);
+}
+
+static void
+on_param_range_changed (win_info* wi)
+{
+  double from = atof (wi->param_from_entry->get_text().c_str());
+  double to   = atof (wi->param_to_entry->get_text().c_str());
+  if (from == to)
+    return;
+
+  wi->param_scale->set_range (min (from, to), max (from, to));
+}
+
+static void
+on_param_scale_changed (win_info* wi)
+{
+  var_enum param;
+  if (!find_param (wi->param_entry->get_text(), param) ||
+      wi->graph_area->is_null_func())
+    return;
+
+  wi->graph_area->set_param (param, wi->param_scale->get_value());
+}
+
+static void
+on_animate_btn_toggled (win_info* wi)
+{
+  wi->anim_timer.disconnect();
+  if (!wi->animate_btn->get_active())
+    return;
+
+  wi->anim_started = wi->anim_shown = Perf::now();
+  wi->anim_frames = 0;
+  wi->anim_total = wi->anim_worst = 0.0;
+
+  start_anim_timer (wi);
+}
+
+// full speed in the focused window only, so that animating in many
+// windows at once doesn't take the processors from the one looked at
+static void
+start_anim_timer (win_info* wi)
+{
+  wi->anim_timer.disconnect();
+
+  int fps = wi->graph_area->is_focused() ? ANIM_FPS : ANIM_BACKGROUND_FPS;
+  wi->anim_timer = Glib::signal_timeout().connect (SigC::bind< win_info* >
+    (SigC::slot (on_animate_tick), wi), 1000 / fps);
+}
+
+// the next frame: the parameter goes from one end of the slider to the
+// other and back, by the clock rather than by the frame, so a slow frame
+// makes the animation jerky but not slower
+static bool
+on_animate_tick (win_info* wi)
+{
+  double now = Perf::now();
+  double phase = fmod ((now - wi->anim_started) / ANIM_SWEEP, 2.0);
+  if (phase > 1.0)
+    phase = 2.0 - phase;
+
+  Gtk::Adjustment *adj = wi->param_scale->get_adjustment();
+  wi->param_scale->set_value (adj->get_lower() +
+                              phase * (adj->get_upper() - adj->get_lower()));
+
+  // on screen now, not when the main loop gets to it; the other windows'
+  // frames wait their turn
+  if (wi->graph_area->is_focused())
+    wi->graph_area->draw_pending();
+
+  double t = wi->graph_area->get_perf().get_timer (PERF_FRAME).last;
+  wi->anim_frames++;
+  wi->anim_total += t;
+  wi->anim_worst = max (wi->anim_worst, t);
+
+  if (now - wi->anim_shown >= 1.0)
+  {
+    char buf[ 128 ];
+    sprintf (buf, "%.1f fps, %.1f ms/frame (worst %.1f)",
+             wi->anim_frames / (now - wi->anim_shown),
+             wi->anim_total / wi->anim_frames * 1e3, wi->anim_worst * 1e3);
+    wi->anim_label->set_text (buf);
+
+    wi->anim_shown = now;
+    wi->anim_frames = 0;
+    wi->anim_total = wi->anim_worst = 0.0;
+  }
+
+  return true;  // until the button is let up
+}
+
+void
+GraphArea::draw_graph (int x, int y, int width, int height)
+{
+  View view = get_view();
+
+  // the renderers work on one byte per pixel; the colors are put in
+  // once everything is drawn
+  Canvas c;
+  c.buf = &levels[0];
+  c.stride = img->get_width();
+  c.pixel_size = 1;
+
+  perf.start (PERF_FRAME);
+
+  if (view_is_empty (prog, y_prog, view, x, y, width, height, shader))
+  { // no curve comes near
+    for (int j = y; j < y + height; j++)
+      fill (&levels[ j * c.stride + x ], &levels[ j * c.stride + x + width ],
+            0);
+    perf.count (PERF_CULLED, width * height);
+  }
+  else
+  {
+    perf.start (PERF_RENDER);
+    render_implicit (prog, view, c, x, y, width, height, shader, precision,
+                     default_num_threads(), &hoisted);
+    perf.stop (PERF_RENDER);
+    perf.count (PERF_POINTS, width * height);
+
+    perf.start (PERF_CURVES);
+    render_explicit (y_prog, view, c, x, y, width, height);
+    perf.stop (PERF_CURVES);
   }
 
-  timer.stop();
-  printf ("time elapsed: %f\n", timer.elapsed());
+  perf.start (PERF_COMPOSE);
+  compose (x, y, width, height);
+  perf.stop (PERF_COMPOSE);
+
+  perf.stop (PERF_FRAME);
+  perf.end_frame();
 }
 
 #if 0
@@ -348,44 +630,81 @@ printf("dx=%d dy=%d, x=%d, y=%d, w=%d, h=%d, destx=%d, desty=%d\n",    delta_x_p
 }
 #endif
 
+// text compiled already, in the session's equations, using no
+// parameters but params
+static bool
+load_equations (const string& text, param_set params,
+                vector< Function >& F, vector< Function >& Y)
+{
+  FunctionEntry e;
+  int i = g_library.find (text);
+  if (i < 0 || !g_library.get (i, e, false) ||
+      ((used_params (e.F) | used_params (e.Y)) & ~params))
+    return false;
+
+  F = e.F;
+  Y = e.Y;
+  return true;
+}
+
 static void
 eqtn_changed (win_info *wi)
 {
-  string eqtn = wi->eqtn_entry->get_text();
-  int equal_sign_pos = eqtn.find ('=');
+  string text = wi->eqtn_entry->get_text();
+  string orig_text = text;
 
-  // make sure there's an equal sign
-  if (equal_sign_pos == string::npos)
-  {
-    equal_sign_pos = 2;
-    eqtn.insert (0, "y = ");
-    wi->eqtn_entry->set_text (eqtn);
-  }
+  // the parameters are the one on the slider and those given a value
+  // before; any other letter is a mistake
+  param_set declared = wi->graph_area->get_bound_params();
+  var_enum chosen;
+  if (find_param (wi->param_entry->get_text(), chosen))
+    declared |= param_bit (chosen);
 
-  // create the 3-D explicit function "F"
-  // f(x,y) = g(x,y)  -->  F(x,y) = f(x,y) - g(x,y)
-  eqtn [equal_sign_pos] = '-';
-  eqtn.insert (equal_sign_pos + 1, 1, '(');
-  eqtn.append (1, ')');
-  
   //TODO: give more detailed errors
   try
   {
-     Function F = eqtn;
-     wi->graph_area->change_graph (wi->graph_area->get_scale(),
-	                           wi->graph_area->get_center_x(),
-				   wi->graph_area->get_center_y(), F);
+    vector< Function > F, Y;
+    wi->graph_area->get_perf().start (PERF_PARSE);
+    if (!load_equations (text, declared, F, Y))
+      compile_equations (text, F, Y, declared);
+    wi->graph_area->get_perf().stop (PERF_PARSE);
+
+    wi->graph_area->change_graph (wi->graph_area->get_scale(),
+                                  wi->graph_area->get_center_x(),
+                                  wi->graph_area->get_center_y(), F, Y);
+    wi->shown_eqtn = text;
   }
   catch (SyntaxException e)
   {
     wi->graph_area->set_null_func();
+    wi->shown_eqtn = "";
   }
   catch (ArgumentException e)
   {
     wi->graph_area->set_null_func();
+    wi->shown_eqtn = "";
   }
 
+  if (text != orig_text)
+    wi->eqtn_entry->set_text (text);
+
   wi->save_as->set_sensitive (!wi->graph_area->is_null_func());
+
+  // keep the parameter chosen if the equations still have it, otherwise
+  // take their first
+  vector< var_enum > params = wi->graph_area->get_params();
+  var_enum param;
+  if (!params.empty() &&
+      (!find_param (wi->param_entry->get_text(), param) ||
+       find (params.begin(), params.end(), param) == params.end()))
+    wi->param_entry->set_text (var_names[ params[0] ]);
+
+  wi->param_scale->set_sensitive (!params.empty());
+  wi->animate_btn->set_sensitive (!params.empty());
+  if (params.empty())
+    wi->animate_btn->set_active (false);
+  else
+    on_param_changed (wi);
 }
 
 static void
@@ -427,19 +746,7 @@ modify_graph_params (win_info* wi)
   }
 
   if (scale != wi->graph_area->get_scale())
-  {
     wi->graph_area->change_graph (scale, center_x, center_y);
-    
-    if (scale < 5.0)
-    {
-      wi->draw_grid_btn->set_active (false);
-      wi->draw_grid_btn->set_sensitive (false);
-    }
-    else
-    {
-      wi->draw_grid_btn->set_sensitive (true);
-    }
-  }
   else
     wi->graph_area->move_graph (center_x, center_y);
 
@@ -454,9 +761,39 @@ on_graph_area_motion_notify (GdkEventMotion *ev, win_info *wi)
   return false;
 }
 
+static bool
+on_graph_window_state (GdkEventWindowState *ev, win_info *wi)
+{
+  wi->graph_area->set_iconified (ev->new_window_state &
+                                 GDK_WINDOW_STATE_ICONIFIED);
+  return false;
+}
+
+static bool
+on_graph_window_focus_in (GdkEventFocus *ev, win_info *wi)
+{
+  wi->graph_area->set_focused (true);
+  if (wi->animate_btn->get_active())
+    start_anim_timer (wi);
+  return false;
+}
+
+static bool
+on_graph_window_focus_out (GdkEventFocus *ev, win_info *wi)
+{
+  wi->graph_area->set_focused (false);
+  if (wi->animate_btn->get_active())
+    start_anim_timer (wi);
+  return false;
+}
+
 static bool
 on_graph_window_delete (GdkEventAny* any, win_info* wi)
 {
+  // the last window closing ends the session
+  if (g_windows.size() == 1)
+    save_current_session();
+
   list< win_info* >::iterator it;
   for (it = g_windows.begin(); it != g_windows.end(); it++)
   {
@@ -475,4 +812,107 @@ on_graph_window_delete (GdkEventAny* any, win_info* wi)
   return false;
 }
 
+static WindowState
+get_window_state (win_info *wi, bool with_image)
+{
+  GraphArea *area = wi->graph_area;
+  WindowState s;
+
+  s.equation = wi->eqtn_entry->get_text();
+  s.scale    = area->get_scale();
+  s.center_x = area->get_center_x();
+  s.center_y = area->get_center_y();
+  wi->graph_window->get_position (s.x, s.y);
+  wi->graph_window->get_size (s.width, s.height);
+
+  s.grid      = area->has_grid();
+  s.hud       = area->has_hud();
+  s.fast_eval = wi->fast_eval->get_active();
+  s.shading   = area->get_shading();
+
+  s.param      = wi->param_entry->get_text();
+  s.param_from = wi->param_from_entry->get_text();
+  s.param_to   = wi->param_to_entry->get_text();
+  vector< var_enum > params = area->get_params();
+  for (int i = 0; i < params.size(); i++)
+    s.bindings.push_back (make_pair (params[i], area->get_param (params[i])));
+
+  if (with_image &&
+      area->get_image (s.image, s.image_width, s.image_height))
+    s.image_key = area->get_image_key();
+
+  return s;
+}
 
+// through the widgets, as if it had all been typed and clicked; the
+// graph itself is drawn when the window is shown
+static void
+apply_window_state (win_info *wi, const WindowState& s)
+{
+  if (s.width > 0 && s.height > 0)
+    wi->graph_window->resize (s.width, s.height);
+  if (s.x >= 0 && s.y >= 0)
+    wi->graph_window->move (s.x, s.y);
+
+  wi->fast_eval->set_active (s.fast_eval);
+  wi->perf_overlay->set_active (s.hud);
+  wi->draw_grid_btn->set_active (s.grid);
+  if (s.shading == SHADE_DISTANCE)
+    wi->shade_distance->set_active (true);
+  else if (s.shading == SHADE_LINEAR)
+    wi->shade_linear->set_active (true);
+  else
+    wi->shade_gamma->set_active (true);
+
+  char buf[ 64 ];
+  sprintf (buf, "%g", s.scale);
+  wi->scale_entry->set_text (buf);
+  sprintf (buf, "%g", s.center_x);
+  wi->center_x_entry->set_text (buf);
+  sprintf (buf, "%g", s.center_y);
+  wi->center_y_entry->set_text (buf);
+  wi->graph_area->change_graph (s.scale, s.center_x, s.center_y);
+
+  for (int i = 0; i < s.bindings.size(); i++)
+    wi->graph_area->set_param (s.bindings[i].first, s.bindings[i].second);
+  wi->param_entry->set_text (s.param);
+  wi->param_from_entry->set_text (s.param_from);
+  wi->param_to_entry->set_text (s.param_to);
+  on_param_range_changed (wi);
+
+  wi->eqtn_entry->set_text (s.equation);
+  if (!s.equation.empty())
+    eqtn_changed (wi);
+
+  if (!s.image.empty())
+    wi->graph_area->set_cached_image (s.image_key, s.image_width,
+                                      s.image_height, s.image);
+}
+
+static void
+save_current_session (void)
+{
+  Session session;
+  session.save_images = g_save_images;
+
+  // each window's equations, compiled, keyed by the text they came from
+  vector< FunctionEntry > equations;
+  list< win_info* >::iterator it;
+  for (it = g_windows.begin(); it != g_windows.end(); it++)
+  {
+    win_info *wi = *it;
+    session.windows.push_back (get_window_state (wi, g_save_images));
+
+    if (!wi->shown_eqtn.empty())
+    {
+      FunctionEntry e;
+      e.source = wi->shown_eqtn;
+      e.F = wi->graph_area->F;
+      e.Y = wi->graph_area->Y;
+      equations.push_back (e);
+    }
+  }
+
+  if (!save_session (g_session_dir, session, equations))
+    perror (g_session_dir.c_str());
+}
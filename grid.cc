@@ -0,0 +1,94 @@
+#include "grid.h"
+#include <math.h>
+#include <float.h>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+void
+grid_spacing (double scale, double& major, double& minor)
+{
+  double min_major = MIN_MAJOR_PX / scale;
+  double decade = pow (10.0, floor (log10 (min_major)));
+
+  if (decade >= min_major)
+    major = decade;
+  else if (2 * decade >= min_major)
+    major = 2 * decade;
+  else if (5 * decade >= min_major)
+    major = 5 * decade;
+  else
+    major = 10 * decade;
+
+  // 2 * 10^k splits into quarters, the others into fifths
+  double first = major / decade;
+  minor = major / ((first > 1.5 && first < 2.5) ? 4 : 5);
+}
+
+// the class of each of n pixels along one axis, where the first pixel
+// starts at the point pt0 and each is pt_per_px long (negative going up)
+static void
+classify (vector< unsigned char >& lines, int n,
+          double spacing_major, double spacing_minor,
+          double pt0, double pt_per_px)
+{
+  lines.assign (n, GRID_NONE);
+
+  double ratio = spacing_major / spacing_minor;
+
+  // a line is on the pixel whose interval holds it
+  double lo = min (pt0, pt0 + n * pt_per_px);
+  double hi = max (pt0, pt0 + n * pt_per_px);
+
+  // once the pixels are closer than double can tell apart, there is no
+  // grid: the lines would land a pixel or more off, and past 2^53 lines
+  // from the origin k would stop counting them
+  double first = ceil (lo / spacing_minor);
+  if (!(fabs (pt_per_px) > max (fabs (lo), fabs (hi)) * DBL_EPSILON) ||
+      !(fabs (first) < 1.0 / DBL_EPSILON))
+    return;
+
+  // the lines on the n pixels, however far from the origin they are
+  int num_lines = (int) (n * fabs (pt_per_px) / spacing_minor) + 2;
+  for (int line = 0; line < num_lines; line++)
+  {
+    double k = first + line;
+    double pt = k * spacing_minor;
+    if (pt >= hi)
+      break;
+
+    int i = (int) floor ((pt - pt0) / pt_per_px);
+    if (i < 0 || i >= n)
+      continue;
+
+    // major lines are every ratio'th minor line
+    double m = fmod (fabs (k), ratio);
+    unsigned char c = (k == 0) ? GRID_AXIS :
+                      (m < 0.5 || m > ratio - 0.5) ? GRID_MAJOR : GRID_MINOR;
+    lines[i] = max (lines[i], c);
+  }
+}
+
+void
+render_grid (const View& view, const Canvas& overlay,
+             int x, int y, int width, int height)
+{
+  double major, minor;
+  grid_spacing (view.scale, major, minor);
+
+  // pixel i covers the points from horiz_px_to_pt (i - 0.5) on
+  vector< unsigned char > cols, rows;
+  classify (cols, width, major, minor,
+            view.horiz_px_to_pt (x - 0.5), 1.0 / view.scale);
+  classify (rows, height, major, minor,
+            view.vert_px_to_pt (y - 0.5), -1.0 / view.scale);
+
+  for (int j = 0; j < height; j++)
+  {
+    unsigned char *dest = overlay.at (x, y + j);
+    unsigned char row = rows[j];
+    for (int i = 0; i < width; i++)
+      dest[ i*overlay.pixel_size ] = max (row, cols[i]);
+  }
+}
@@ -0,0 +1,29 @@
+#ifndef _GRID_H_
+#define _GRID_H_
+
+#include "view.h"
+#include "render.h"
+
+// what each pixel of a grid overlay is part of; the highest class wins
+// where lines cross
+enum grid_enum
+{
+  GRID_NONE,
+  GRID_MINOR,
+  GRID_MAJOR,
+  GRID_AXIS,
+  NUM_GRID_CLASSES
+};
+
+// the major spacing is the smallest of 1, 2 or 5 times a power of ten
+// that leaves at least MIN_MAJOR_PX pixels between lines, so the grid
+// looks the same at every scale; the minor lines split it in 5, 4 or 5
+#define MIN_MAJOR_PX 80
+
+void grid_spacing (double scale, double& major, double& minor);
+
+// writes the grid_enum of every pixel of the rectangle into overlay
+void render_grid (const View& view, const Canvas& overlay,
+                  int x, int y, int width, int height);
+
+#endif
@@ -0,0 +1,249 @@
+#include "interval.h"
+#include "func.h"
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+
+using namespace std;
+
+namespace Math {
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+Interval
+Interval::empty (void)
+{
+  return Interval (HUGE_VAL, -HUGE_VAL);
+}
+
+Interval
+Interval::entire (void)
+{
+  return Interval (-HUGE_VAL, HUGE_VAL);
+}
+
+// libm is good to an ulp or two; move the ends out by a few more
+static Interval
+outward (double lo, double hi)
+{
+  if (lo != lo || hi != hi)       // NaN from inf - inf and the like
+    return Interval::entire();
+
+  return Interval (lo - fabs (lo) * 1e-15 - 1e-300,
+                   hi + fabs (hi) * 1e-15 + 1e-300);
+}
+
+static Interval
+hull (double a, double b, double c, double d)
+{
+  return outward (min (min (a, b), min (c, d)), max (max (a, b), max (c, d)));
+}
+
+// the same rule as Function: anything times 0 is 0, even infinity
+static double
+mult (double a, double b)
+{
+  return (a == 0.0 || b == 0.0) ? 0.0 : a * b;
+}
+
+static Interval
+mult (const Interval& a, const Interval& b)
+{
+  return hull (mult (a.lo, b.lo), mult (a.lo, b.hi),
+               mult (a.hi, b.lo), mult (a.hi, b.hi));
+}
+
+static Interval
+div (const Interval& a, const Interval& b)
+{
+  if (a.lo == 0.0 && a.hi == 0.0)
+    return Interval (0.0);          // 0 / anything is 0 for Function
+  if (b.contains (0.0))
+    return Interval::entire();
+
+  return hull (a.lo / b.lo, a.lo / b.hi, a.hi / b.lo, a.hi / b.hi);
+}
+
+static Interval
+recip (const Interval& a)
+{
+  if (a.contains (0.0))
+    return Interval::entire();
+  return hull (1.0 / a.lo, 1.0 / a.hi, 1.0 / a.lo, 1.0 / a.hi);
+}
+
+static Interval
+power (const Interval& a, const Interval& b)
+{
+  // a fixed integer power, like x^2
+  if (b.lo == b.hi && b.lo == floor (b.lo) && fabs (b.lo) < 1e9)
+  {
+    double n = b.lo;
+    if (n == 0.0)
+      return Interval (1.0);
+
+    Interval r = hull (pow (a.lo, n), pow (a.hi, n),
+                       pow (a.lo, n), pow (a.hi, n));
+    if (a.contains (0.0) && a.lo != a.hi)
+    {
+      if (n < 0.0)
+        return Interval::entire();
+      if (fmod (n, 2.0) == 0.0)
+        r.lo = 0.0;
+    }
+    return r;
+  }
+
+  // monotonic in each argument where the base is positive
+  if (a.lo >= 0.0 && (a.lo > 0.0 || b.lo > 0.0))
+    return hull (pow (a.lo, b.lo), pow (a.lo, b.hi),
+                 pow (a.hi, b.lo), pow (a.hi, b.hi));
+
+  return Interval::entire();
+}
+
+// f increasing on its domain [d_lo, d_hi]
+static Interval
+increasing (double (*f)(double), const Interval& a, double d_lo, double d_hi)
+{
+  double lo = max (a.lo, d_lo), hi = min (a.hi, d_hi);
+  if (!(lo <= hi))
+    return Interval::empty();
+  return outward (f (lo), f (hi));
+}
+
+static Interval
+decreasing (double (*f)(double), const Interval& a, double d_lo, double d_hi)
+{
+  double lo = max (a.lo, d_lo), hi = min (a.hi, d_hi);
+  if (!(lo <= hi))
+    return Interval::empty();
+  return outward (f (hi), f (lo));
+}
+
+// f (x) = sin (x + phase) over a, by its value at the ends and at any
+// peak in between. f is sin or cos itself: adding the phase first would
+// round x, by more than outward() allows for once x is large.
+static Interval
+sine (const Interval& a, double (*f)(double), double phase)
+{
+  // k 2pi, and the k found for it, are off by a few ulps of x, so the
+  // peaks are looked for that much beyond a: one that is not really
+  // there only widens the bound. Far from 0 that covers every period.
+  double slack = 16 * DBL_EPSILON * (max (fabs (a.lo), fabs (a.hi)) + M_PI);
+  if (!(a.hi - a.lo + 2 * slack < 2 * M_PI))
+    return Interval (-1.0, 1.0);
+
+  double lo = min (f (a.lo), f (a.hi));
+  double hi = max (f (a.lo), f (a.hi));
+
+  double from = a.lo + phase - slack, to = a.hi + phase + slack;
+
+  // peaks at pi/2 + 2k pi, troughs at -pi/2 + 2k pi
+  double first_peak = ceil ((from - M_PI/2) / (2*M_PI));
+  if ((first_peak * 2*M_PI + M_PI/2) <= to)
+    hi = 1.0;
+  double first_trough = ceil ((from + M_PI/2) / (2*M_PI));
+  if ((first_trough * 2*M_PI - M_PI/2) <= to)
+    lo = -1.0;
+
+  Interval r = outward (lo, hi);
+  r.lo = max (r.lo, -1.0);
+  r.hi = min (r.hi, 1.0);
+  return r;
+}
+
+static Interval
+tangent (const Interval& a)
+{
+  // one branch, between two poles at pi/2 + k pi
+  double k = ceil ((a.lo - M_PI/2) / M_PI);
+  if (!(a.hi - a.lo < M_PI) || k * M_PI + M_PI/2 <= a.hi)
+    return Interval::entire();
+  return outward (tan (a.lo), tan (a.hi));
+}
+
+static Interval
+magnitude (const Interval& a)
+{
+  if (a.lo >= 0.0)
+    return a;
+  if (a.hi <= 0.0)
+    return Interval (-a.hi, -a.lo);
+  return Interval (0.0, max (-a.lo, a.hi));
+}
+
+static Interval
+hyperbolic_cosine (const Interval& a)
+{
+  Interval m = magnitude (a);
+  return outward (cosh (m.lo), cosh (m.hi));
+}
+
+static double log_10 (double d) { return log10 (d); }
+
+Interval
+eval_op (ops_enum op, const Interval& a, const Interval& b)
+{
+  // Function takes 0 * NaN and 0 / NaN to be 0, so a factor or a
+  // numerator that can be 0 still gives 0 where the other is undefined
+  if (op == op_mult && (a.is_empty() || b.is_empty()))
+    return (a.contains (0.0) || b.contains (0.0)) ?
+             Interval (0.0) : Interval::empty();
+  if (op == op_div && b.is_empty() && !a.is_empty())
+    return a.contains (0.0) ? Interval (0.0) : Interval::empty();
+
+  if (a.is_empty() || (op >= op_plus && b.is_empty()))
+    return Interval::empty();
+
+  const double inf = HUGE_VAL;
+
+  switch (op)
+  {
+    case op_plus:  return outward (a.lo + b.lo, a.hi + b.hi);
+    case op_minus: return outward (a.lo - b.hi, a.hi - b.lo);
+    case op_mult:  return mult (a, b);
+    case op_div:   return div (a, b);
+    case op_pow:   return power (a, b);
+
+    case op_sin:   return sine (a, sin, 0.0);
+    case op_cos:   return sine (a, cos, M_PI/2);
+    case op_tan:   return tangent (a);
+    case op_csc:   return recip (sine (a, sin, 0.0));
+    case op_sec:   return recip (sine (a, cos, M_PI/2));
+    case op_cot:   return recip (tangent (a));
+
+    case op_asin:  return increasing (asin, a, -1.0, 1.0);
+    case op_acos:  return decreasing (acos, a, -1.0, 1.0);
+    case op_atan:  return increasing (atan, a, -inf, inf);
+    case op_acsc:  return increasing (asin, recip (a), -1.0, 1.0);
+    case op_asec:  return decreasing (acos, recip (a), -1.0, 1.0);
+    case op_acot:  return increasing (atan, recip (a), -inf, inf);
+
+    case op_sinh:  return increasing (sinh, a, -inf, inf);
+    case op_cosh:  return hyperbolic_cosine (a);
+    case op_tanh:  return increasing (tanh, a, -inf, inf);
+    case op_csch:  return recip (increasing (sinh, a, -inf, inf));
+    case op_sech:  return recip (hyperbolic_cosine (a));
+    case op_coth:  return recip (increasing (tanh, a, -inf, inf));
+
+    case op_asinh: return increasing (asinh, a, -inf, inf);
+    case op_acosh: return increasing (acosh, a, 1.0, inf);
+    case op_atanh: return increasing (atanh, a, -1.0, 1.0);
+
+    case op_log:   return increasing (log_10, a, 0.0, inf);
+    case op_ln:    return increasing (log, a, 0.0, inf);
+    case op_exp:   return increasing (exp, a, -inf, inf);
+    case op_sqrt:  return increasing (sqrt, a, 0.0, inf);
+    case op_abs:   return magnitude (a);
+
+    default:       break;
+  }
+
+  // acsch, asech, acoth: not worth the trouble
+  return Interval::entire();
+}
+
+} // namespace Math
@@ -0,0 +1,42 @@
+#ifndef _INTERVAL_H_
+#define _INTERVAL_H_
+
+#include "func.h"
+
+namespace Math
+{
+  // A closed range [lo, hi] that is known to hold a value. Evaluating a
+  // Program on the intervals of x and y over a box bounds the equations
+  // over the whole box, which is how tiles with nothing in them are found
+  // without drawing them. The bounds are rounded outwards, so they may be
+  // loose, but never wrong. Where a function is undefined, like sqrt of
+  // a negative, the points are dropped: they can never be drawn anyway.
+  struct Interval
+  {
+    double lo, hi;
+
+    Interval (void) {}
+    Interval (double d)
+    {
+      lo = hi = d;
+    }
+    Interval (double lo, double hi)
+    {
+      this->lo = lo;
+      this->hi = hi;
+    }
+
+    // no value at all, when the whole range is outside a domain
+    static Interval empty (void);
+    // nothing known
+    static Interval entire (void);
+
+    bool is_empty (void) const { return !(lo <= hi); }
+    bool contains (double d) const { return lo <= d && d <= hi; }
+  };
+
+  // eval_op for every value in the intervals
+  Interval eval_op (ops_enum op, const Interval& arg1, const Interval& arg2);
+}
+
+#endif
@@ -0,0 +1,297 @@
+/*
+ * op_bench: what each operation, and each derivative rule, costs.
+ *
+ *   op_bench [-p points] [-n runs]
+ *
+ * For every operation, the time per point of
+ *   scalar   eval_op(), one point at a time, as Function goes
+ *   double   Program::eval_batch() in double, BATCH points at a time,
+ *            as the renderer goes when float isn't enough
+ *   float    the same in float
+ * over points spread across the inputs the operation usually gets: its
+ * domain for the inverse functions, a few periods for the others. The
+ * batches include loading the arguments. The composite operations, like
+ * acsch, are built from several libm calls and cost accordingly.
+ *
+ * Then for every derivative rule, the time Function::differentiate()
+ * takes on op(x*y), or x*y op (x+y) for the infix ones, and the size of
+ * the derivative: RPN elements, and nodes once compiled into a Program.
+ * The first line is the argument alone, which every other line includes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <string>
+#include <vector>
+
+#include "func.h"
+#include "parse.h"
+#include "program.h"
+
+using namespace std;
+using namespace Math;
+
+// where each operation's arguments are drawn from; with 'either_sign'
+// the magnitude is in [lo, hi] and the sign is random
+struct OpInput
+{
+  ops_enum op;
+  double lo, hi;
+  bool either_sign;
+  double lo2, hi2;   // the second argument, for the infix operations
+};
+
+static const OpInput inputs[] =
+{
+  { op_sin,   -10,  10, false,     0,  0 },
+  { op_cos,   -10,  10, false,     0,  0 },
+  { op_tan,   -10,  10, false,     0,  0 },
+  { op_csc,   -10,  10, false,     0,  0 },
+  { op_sec,   -10,  10, false,     0,  0 },
+  { op_cot,   -10,  10, false,     0,  0 },
+  { op_asin,   -1,   1, false,     0,  0 },
+  { op_acos,   -1,   1, false,     0,  0 },
+  { op_atan,  -10,  10, false,     0,  0 },
+  { op_acsc,    1,  10, true,      0,  0 },
+  { op_asec,    1,  10, true,      0,  0 },
+  { op_acot,  -10,  10, false,     0,  0 },
+  { op_sinh,  -10,  10, false,     0,  0 },
+  { op_cosh,  -10,  10, false,     0,  0 },
+  { op_tanh,  -10,  10, false,     0,  0 },
+  { op_csch,  -10,  10, false,     0,  0 },
+  { op_sech,  -10,  10, false,     0,  0 },
+  { op_coth,  -10,  10, false,     0,  0 },
+  { op_asinh, -10,  10, false,     0,  0 },
+  { op_acosh,   1,  10, false,     0,  0 },
+  { op_atanh,  -1,   1, false,     0,  0 },
+  { op_acsch, -10,  10, false,     0,  0 },
+  { op_asech,   0,   1, false,     0,  0 },
+  { op_acoth,   1,  10, true,      0,  0 },
+  { op_log,  0.01, 100, false,     0,  0 },
+  { op_ln,   0.01, 100, false,     0,  0 },
+  { op_exp,   -10,  10, false,     0,  0 },
+  { op_sqrt,    0, 100, false,     0,  0 },
+  { op_abs,   -10,  10, false,     0,  0 },
+  { op_plus,  -10,  10, false, -10, 10 },
+  { op_minus, -10,  10, false, -10, 10 },
+  { op_mult,  -10,  10, false, -10, 10 },
+  { op_div,   -10,  10, false, -10, 10 },
+  { op_pow,   0.1,  10, false,  -3,  3 },
+};
+
+#define NUM_INPUTS ((int) (sizeof (inputs) / sizeof (inputs[0])))
+
+static double
+now (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static string
+op_name (ops_enum op)
+{
+  string name = op_names[ op ];
+  if (name.size() > 1 && name[ name.size() - 1 ] == '(')
+    name.erase (name.size() - 1);
+  return name;
+}
+
+// the same numbers every run
+static double
+random_in (unsigned& seed, double lo, double hi, bool either_sign)
+{
+  seed = seed * 1103515245 + 12345;
+  double u = ((seed >> 8) & 0xFFFFFF) / (double) 0x1000000;
+  double v = lo + u * (hi - lo);
+  return (either_sign && (seed & 0x80000000)) ? -v : v;
+}
+
+// op of x, or of x and y
+static Function
+op_function (ops_enum op, bool infix)
+{
+  vector< Variant > RPN;
+  RPN.push_back (var_x);
+  if (infix)
+    RPN.push_back (var_y);
+  RPN.push_back (op);
+  return Function::FromRPN (RPN);
+}
+
+// seconds per point for the whole of prog, BATCH points at a time
+template< class T >
+static double
+time_batch (const Program& prog, const vector< double >& xs,
+            const vector< double >& ys, int runs)
+{
+  const int B = Program::BATCH;
+  int n = xs.size();
+
+  vector< T > x (xs.begin(), xs.end()), y (ys.begin(), ys.end());
+  vector< T > regs (prog.get_num_nodes() * B);
+  volatile T sink = 0;
+
+  double best = 1e300;
+  for (int r = 0; r < runs; r++)
+  {
+    double start = now();
+    for (int i = 0; i < n; i += B)
+    {
+      const T *var_values[ NUM_VARS ] = { &x[i], &y[i] };
+      prog.eval_batch (0, prog.get_num_nodes(), var_values, &regs[0]);
+      sink += regs[ (prog.get_num_nodes() - 1) * B ];
+    }
+    best = min (best, now() - start);
+  }
+
+  return best / n;
+}
+
+static double
+time_scalar (ops_enum op, const vector< double >& xs,
+             const vector< double >& ys, int runs)
+{
+  int n = xs.size();
+  volatile double sink = 0;
+
+  double best = 1e300;
+  for (int r = 0; r < runs; r++)
+  {
+    double start = now();
+    double sum = 0;
+    for (int i = 0; i < n; i++)
+      sum += eval_op (op, xs[i], ys[i]);
+    sink += sum;
+    best = min (best, now() - start);
+  }
+
+  return best / n;
+}
+
+static void
+bench_ops (int points, int runs)
+{
+  printf ("%-8s %-22s %10s %10s %10s %8s\n",
+          "op", "inputs", "scalar ns", "double ns", "float ns", "speedup");
+
+  for (int k = 0; k < NUM_INPUTS; k++)
+  {
+    const OpInput& in = inputs[k];
+    bool infix = Variant (in.op).is_infix_op();
+
+    unsigned seed = 1;
+    vector< double > xs (points), ys (points, 0.0);
+    for (int i = 0; i < points; i++)
+    {
+      xs[i] = random_in (seed, in.lo, in.hi, in.either_sign);
+      if (infix)
+        ys[i] = random_in (seed, in.lo2, in.hi2, false);
+    }
+
+    Program prog (vector< Function > (1, op_function (in.op, infix)));
+
+    double scalar = time_scalar (in.op, xs, ys, runs);
+    double batch_d = time_batch< double > (prog, xs, ys, runs);
+    double batch_f = time_batch< float > (prog, xs, ys, runs);
+
+    char range[ 64 ];
+    if (infix)
+      sprintf (range, "[%g,%g] x [%g,%g]", in.lo, in.hi, in.lo2, in.hi2);
+    else
+      sprintf (range, "%s[%g,%g]", in.either_sign ? "+-" : "", in.lo, in.hi);
+
+    printf ("%-8s %-22s %10.2f %10.2f %10.2f %7.1fx\n",
+            op_name (in.op).c_str(), range, scalar * 1e9, batch_d * 1e9,
+            batch_f * 1e9, scalar / min (batch_d, batch_f));
+  }
+}
+
+// differentiates f until at least 'budget' seconds have passed, and
+// prints the time per call and the size of the result
+static void
+bench_deriv (const char *what, const Function& f, double budget)
+{
+  Function d;
+  int calls = 0;
+  double start = now(), elapsed;
+  do
+  {
+    d = f.differentiate (var_x);
+    calls++;
+  } while ((elapsed = now() - start) < budget);
+
+  Program prog (vector< Function > (1, d));
+
+  printf ("%-8s %10.2f %12d %12d %12d\n", what, elapsed / calls * 1e6,
+          (int) f.get_rpn_stack().size(), (int) d.get_rpn_stack().size(),
+          prog.get_num_nodes());
+}
+
+static void
+bench_derivs (double budget)
+{
+  printf ("\n%-8s %10s %12s %12s %12s\n",
+          "rule", "us/call", "RPN in", "RPN out", "nodes out");
+
+  // x*y, and x+y for the right hand side of the infix operations
+  vector< Variant > x_y, x_plus_y;
+  x_y.push_back (var_x);
+  x_y.push_back (var_y);
+  x_plus_y = x_y;
+  x_y.push_back (op_mult);
+  x_plus_y.push_back (op_plus);
+
+  bench_deriv ("(x*y)", Function::FromRPN (x_y), budget);
+
+  for (int k = 0; k < NUM_INPUTS; k++)
+  {
+    ops_enum op = inputs[k].op;
+
+    vector< Variant > RPN = x_y;
+    if (Variant (op).is_infix_op())
+      RPN.insert (RPN.end(), x_plus_y.begin(), x_plus_y.end());
+    RPN.push_back (op);
+
+    bench_deriv (op_name (op).c_str(), Function::FromRPN (RPN), budget);
+  }
+}
+
+static void
+usage (void)
+{
+  fprintf (stderr, "usage: op_bench [-p points] [-n runs]\n");
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  int points = 1 << 16;
+  int runs = 5;
+
+  int opt;
+  while ((opt = getopt (argc, argv, "p:n:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'p': points = atoi (optarg); break;
+      case 'n': runs   = atoi (optarg); break;
+      default:  usage();
+    }
+  }
+  if (optind != argc || points <= 0 || runs <= 0)
+    usage();
+
+  // whole batches
+  points = (points + Program::BATCH - 1) / Program::BATCH * Program::BATCH;
+
+  printf ("%d points per operation, best of %d runs\n\n", points, runs);
+  bench_ops (points, runs);
+  bench_derivs (0.02);
+
+  return 0;
+}
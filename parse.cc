@@ -7,10 +7,43 @@
 using namespace std;
 using namespace Math;
 
-static vector< Variant >
-rpn_process_string (const string& expr, int start, int len, int* paren_map);
+// the RPN being built, and the span of the text each element came from
+struct Output
+{
+  vector< Variant > RPN;
+  vector< Span > spans;
+
+  void push (const Variant& v, int begin, int end)
+  {
+    Span s = { begin, end };
+    RPN.push_back (v);
+    spans.push_back (s);
+  }
+
+  void append (const Output& other)
+  {
+    RPN.insert (RPN.end(), other.RPN.begin(), other.RPN.end());
+    spans.insert (spans.end(), other.spans.begin(), other.spans.end());
+  }
+};
+
+// an infix operation waiting for its right hand side, and where it was
+struct PendingOp
+{
+  ops_enum op;
+  Span span;
+};
+
+static Output
+rpn_process_string (const string& expr, int start, int len, int* paren_map,
+                    param_set params);
 
-const char* var_names[] = {"x", "y"};
+const char* var_names[] = {
+  "x", "y",
+  // the parameters
+  "a", "b", "c", "d", "e", "f", "g", "h", "i", "j", "k", "l", "m",
+  "n", "o", "p", "q", "r", "s", "t", "u", "v", "w", "z"
+};
 const char* op_names[]  = {
   "sin(",          // op_sin
   "cos(",          // op_cos
@@ -84,6 +117,19 @@ find_matching_str (const string& str, int pos, const char **search, int num)
   return i;
 }
 
+// the variable at pos: x, y or a parameter in params; NUM_VALUES if
+// there is none
+static var_enum
+find_variable (const string& expr, int pos, param_set params)
+{
+  var_enum var = (var_enum) find_matching_str (expr, pos, var_names,
+                                               NUM_VALUES);
+  if (var != NUM_VALUES && is_param (var) && !(params & param_bit (var)))
+    return (var_enum) NUM_VALUES;
+
+  return var;
+}
+
 static int precedence (ops_enum op)
 {
   switch (op)
@@ -102,10 +148,10 @@ static int precedence (ops_enum op)
   return -1;
 }
 
+// len is 0 for the implicit multiplications, which have no text
 static void
-rpn_process_infix_op (Variant& last_in_str, int& i, ops_enum op,
-                      vector< ops_enum >& ops_stack,
-          vector< Variant >& RPN)
+rpn_process_infix_op (Variant& last_in_str, int& i, ops_enum op, int len,
+                      vector< PendingOp >& ops_stack, Output& out)
 {
   if (last_in_str.is_infix_op()) // can't have 2 in a row
     throw SyntaxException (i);
@@ -113,13 +159,15 @@ rpn_process_infix_op (Variant& last_in_str, int& i, ops_enum op,
   int op_order = precedence (op);
         
   while (!ops_stack.empty() && 
-    precedence (ops_stack.back()) >= op_order)
+    precedence (ops_stack.back().op) >= op_order)
   {
-    RPN.push_back (ops_stack.back());
+    out.push (ops_stack.back().op, ops_stack.back().span.begin,
+              ops_stack.back().span.end);
     ops_stack.pop_back();
   }
 
-  ops_stack.push_back (op);
+  PendingOp pending = { op, { i, i + len } };
+  ops_stack.push_back (pending);
 
   // record the current element
   last_in_str = op;
@@ -128,11 +176,11 @@ rpn_process_infix_op (Variant& last_in_str, int& i, ops_enum op,
 static void
 rpn_process_constant (Variant& last_in_str, int& i, const string& expr,
                       int start, int len,
-          vector< ops_enum >& ops_stack, vector< Variant >& RPN)
+                      vector< PendingOp >& ops_stack, Output& out)
 {
   // insert op_mult if necessary
   if (! last_in_str.is_infix_op())
-    rpn_process_infix_op (last_in_str, i, op_mult, ops_stack, RPN);
+    rpn_process_infix_op (last_in_str, i, op_mult, 0, ops_stack, out);
   
   char cur = expr[i];
   
@@ -151,7 +199,7 @@ rpn_process_constant (Variant& last_in_str, int& i, const string& expr,
   }
 
   double val = atof (expr.substr (i, j-i).c_str());
-  RPN.push_back (val);
+  out.push (val, i, j);
       
   // record the current element
   last_in_str = val;
@@ -162,12 +210,12 @@ rpn_process_constant (Variant& last_in_str, int& i, const string& expr,
 
 static void
 rpn_process_diff_op (Variant& last_in_str, int& i, const string& expr,
-                     int start, int len, int *paren_map,
-         vector< ops_enum >& ops_stack, vector< Variant >& RPN)
+                     int start, int len, int *paren_map, param_set params,
+                     vector< PendingOp >& ops_stack, Output& out)
 {
   // insert op_mult if necessary
   if (! last_in_str.is_infix_op())
-    rpn_process_infix_op (last_in_str, i, op_mult, ops_stack, RPN);
+    rpn_process_infix_op (last_in_str, i, op_mult, 0, ops_stack, out);
   
   int after_op = i + strlen (op_names[ op_differentiate ]); // skip the op
   
@@ -180,10 +228,9 @@ rpn_process_diff_op (Variant& last_in_str, int& i, const string& expr,
 
   comma_pos += after_op; // in absolute coords
       
-  var_enum differential =
-    (var_enum) find_matching_str (expr, comma_pos + 1, var_names, NUM_VARS);
+  var_enum differential = find_variable (expr, comma_pos + 1, params);
       
-  if (differential == NUM_VARS)
+  if (differential == NUM_VALUES)
     throw SyntaxException (comma_pos + 1);
 
   // make sure there's nothing appended
@@ -192,7 +239,8 @@ rpn_process_diff_op (Variant& last_in_str, int& i, const string& expr,
     throw SyntaxException (comma_pos + 1);
       
   vector< Variant > diff_func_RPN =
-    rpn_process_string (expr, after_op, comma_pos - after_op, paren_map);
+    rpn_process_string (expr, after_op, comma_pos - after_op, paren_map,
+                        params).RPN;
       
   if (diff_func_RPN.empty())
     throw SyntaxException (comma_pos);
@@ -202,7 +250,9 @@ rpn_process_diff_op (Variant& last_in_str, int& i, const string& expr,
   vector< Variant > add_to_RPN = 
     diff_func.differentiate (differential).get_rpn_stack();
 
-  RPN.insert (RPN.end(), add_to_RPN.begin(), add_to_RPN.end());
+  // the derivative has no text of its own; it is all of "deriv(...)"
+  for (int k = 0; k < add_to_RPN.size(); k++)
+    out.push (add_to_RPN[k], i, paren_map[after_op - 1] + 1);
 
   // record the current element
   last_in_str = op_differentiate;
@@ -213,26 +263,26 @@ rpn_process_diff_op (Variant& last_in_str, int& i, const string& expr,
 
 static void
 rpn_process_paren_op (Variant& last_in_str, int& i, const string& expr,
-                      int *paren_map, ops_enum op,
-                      vector< ops_enum >& ops_stack, vector< Variant >& RPN)
+                      int *paren_map, param_set params, ops_enum op,
+                      vector< PendingOp >& ops_stack, Output& out)
 {
   // insert op_mult if necessary
   if (! last_in_str.is_infix_op())
-    rpn_process_infix_op (last_in_str, i, op_mult, ops_stack, RPN);
+    rpn_process_infix_op (last_in_str, i, op_mult, 0, ops_stack, out);
   
   int after_op = i + strlen (op_names[ op ]); // skip to position after op
   
-  vector< Variant > add_to_RPN =
+  Output add_to_RPN =
     rpn_process_string (expr, after_op, paren_map[after_op - 1] - after_op,
-                    paren_map);
+                    paren_map, params);
          
-  if (add_to_RPN.empty())
+  if (add_to_RPN.RPN.empty())
     throw ArgumentException (i, paren_map[after_op - 1]);
         
-  RPN.insert (RPN.end(), add_to_RPN.begin(), add_to_RPN.end());
+  out.append (add_to_RPN);
 
   if (op != op_openparen) // op is sin(), abs(), sqrt()...
-    RPN.push_back (op);
+    out.push (op, i, after_op);   // the name, not the argument
 
   // record the current element
   last_in_str = op;
@@ -243,13 +293,13 @@ rpn_process_paren_op (Variant& last_in_str, int& i, const string& expr,
 
 static void
 rpn_process_variable (Variant& last_in_str, int& i, var_enum var,
-                      vector< ops_enum >& ops_stack, vector< Variant >& RPN)
+                      vector< PendingOp >& ops_stack, Output& out)
 {
   // insert op_mult if necessary
   if (! last_in_str.is_infix_op())
-    rpn_process_infix_op (last_in_str, i, op_mult, ops_stack, RPN);
+    rpn_process_infix_op (last_in_str, i, op_mult, 0, ops_stack, out);
   
-  RPN.push_back (var);
+  out.push (var, i, i + strlen (var_names[ (int)var ]));
 
   // record the current element
   last_in_str = var;
@@ -258,11 +308,12 @@ rpn_process_variable (Variant& last_in_str, int& i, var_enum var,
   i += strlen (var_names[ (int)var ]) - 1;
 }
 
-static vector< Variant >
-rpn_process_string (const string& expr, int start, int len, int* paren_map)
+static Output
+rpn_process_string (const string& expr, int start, int len, int* paren_map,
+                    param_set params)
 {
-  vector< Variant > RPN;
-  vector< ops_enum > ops_stack;
+  Output out;
+  vector< PendingOp > ops_stack;
 
   Variant last_in_str (op_plus); // imagine there's a plus in front
 
@@ -271,7 +322,7 @@ rpn_process_string (const string& expr, int start, int len, int* paren_map)
     char cur = expr[i];
     if (cur == '.' || isdigit (cur))
     { // start of a constant
-      rpn_process_constant (last_in_str, i, expr, start, len, ops_stack, RPN);
+      rpn_process_constant (last_in_str, i, expr, start, len, ops_stack, out);
     }
     else
     { // not a constant
@@ -286,25 +337,24 @@ rpn_process_string (const string& expr, int start, int len, int* paren_map)
           case op_mult:
           case op_div:
           case op_pow:
-            rpn_process_infix_op (last_in_str, i, op, ops_stack, RPN);
+            rpn_process_infix_op (last_in_str, i, op, 1, ops_stack, out);
             break;
           case op_differentiate:
             rpn_process_diff_op (last_in_str, i, expr, start, len, paren_map,
-                                 ops_stack, RPN);
+                                 params, ops_stack, out);
             break;
           default: // (assumed to be parentheses or sin(), sqrt(), ...)
-            rpn_process_paren_op (last_in_str, i, expr, paren_map, op,
-                                  ops_stack, RPN);
+            rpn_process_paren_op (last_in_str, i, expr, paren_map, params,
+                                  op, ops_stack, out);
             break;
         }
       }
       else
       { // it should be a variable
-        var_enum var = (var_enum) find_matching_str (expr, i, var_names,
-                                                     NUM_VARS);
-        if (var == NUM_VARS) // not a variable either, give up
+        var_enum var = find_variable (expr, i, params);
+        if (var == NUM_VALUES) // not a variable either, give up
           throw SyntaxException (i);
-        rpn_process_variable (last_in_str, i, var, ops_stack, RPN);
+        rpn_process_variable (last_in_str, i, var, ops_stack, out);
       }
     }
   }
@@ -313,15 +363,16 @@ rpn_process_string (const string& expr, int start, int len, int* paren_map)
     throw SyntaxException (start + len - 1);
 
   for (int i = ops_stack.size() - 1; i >= 0; i--)
-    RPN.push_back (ops_stack[i]);
+    out.push (ops_stack[i].op, ops_stack[i].span.begin,
+              ops_stack[i].span.end);
   
-  return RPN;
+  return out;
 }
 
 vector< Variant >
-parse_into_RPN (string& expr)
+parse_into_RPN (string& expr, vector< Span > *spans, param_set params)
 {
-  vector< Variant > RPN_stack;
+  Output out;
   
   // remove all spaces
   int i = 0;
@@ -369,10 +420,13 @@ parse_into_RPN (string& expr)
   if (!open_paren_stack.empty())
     throw SyntaxException (open_paren_stack.back());
 
-  RPN_stack = rpn_process_string (expr, 0, expr.size(), paren_map);
+  out = rpn_process_string (expr, 0, expr.size(), paren_map, params);
   
   delete [] paren_map;
+
+  if (spans)
+    *spans = out.spans;
   
-  return RPN_stack;
+  return out.RPN;
 }
 
@@ -5,10 +5,16 @@
 #include <string>
 #include "func.h"
 
-// warning: expr will be altered
-std::vector< Math::Variant > parse_into_RPN (std::string& expr);
+// warning: expr will be altered. If spans isn't NULL, it gets the part
+// of the altered expr each element of the RPN came from. Of the
+// parameters, only those in params are recognised.
+std::vector< Math::Variant > parse_into_RPN (std::string& expr,
+                                             std::vector< Math::Span > *spans
+                                               = NULL,
+                                             Math::param_set params
+                                               = Math::NO_PARAMS);
 
 extern const char* op_names [ Math::NUM_OPS ];
-extern const char* var_names[ Math::NUM_VARS ];
+extern const char* var_names[ Math::NUM_VALUES ];  // x, y, a, b, ...
   
 #endif
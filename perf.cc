@@ -0,0 +1,165 @@
+#include "perf.h"
+#include <string.h>
+#include <sys/time.h>
+
+using namespace std;
+
+static const char *timer_names[ NUM_PERF_TIMERS ] =
+{ "parse", "deriv", "compile", "render", "curves", "compose", "frame" };
+
+static const char *counter_names[ NUM_PERF_COUNTERS ] =
+{ "points", "culled", "grid_hits", "grid_misses" };
+
+Perf::Perf (void)
+{
+  started = now();
+  memset (running, 0, sizeof (running));
+  memset (timers, 0, sizeof (timers));
+  memset (counters, 0, sizeof (counters));
+  memset (&frame, 0, sizeof (frame));
+}
+
+double
+Perf::now (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+void
+Perf::stop (perf_timer_enum t)
+{
+  double s = now() - running[t];
+
+  Timer& timer = timers[t];
+  timer.count++;
+  timer.last = s;
+  timer.total += s;
+  if (s > timer.max)
+    timer.max = s;
+
+  frame.seconds[t] += s;
+}
+
+void
+Perf::end_frame (void)
+{
+  frame.at = now() - started;
+  frames.push_back (frame);
+  if (frames.size() > MAX_FRAMES)
+    frames.pop_front();
+
+  memset (&frame, 0, sizeof (frame));
+}
+
+double
+Perf::points_per_second (void) const
+{
+  double t = timers[ PERF_RENDER ].total;
+  return (t > 0.0) ? counters[ PERF_POINTS ] / t : 0.0;
+}
+
+double
+Perf::frames_per_second (double window) const
+{
+  double since = now() - started - window;
+
+  int n = 0;
+  for (int i = frames.size() - 1; i >= 0 && frames[i].at > since; i--)
+    n++;
+
+  return n / window;
+}
+
+static double
+percent (long part, long whole)
+{
+  return whole ? 100.0 * part / whole : 0.0;
+}
+
+string
+Perf::summary (void) const
+{
+  const Timer *t = timers;
+  long looked_at = counters[ PERF_POINTS ] + counters[ PERF_CULLED ];
+  long grid_uses = counters[ PERF_GRID_HITS ] + counters[ PERF_GRID_MISSES ];
+
+  char buf[ 512 ];
+  sprintf (buf,
+           "frame %.1f ms (max %.1f), %d frames, %.1f fps\n"
+           "render %.1f  curves %.1f  colors %.1f ms\n"
+           "parse %.2f  deriv %.2f  compile %.2f ms\n"
+           "%.1f M points/s, %.0f%% culled\n"
+           "grid cache %.0f%% hits",
+           t[ PERF_FRAME ].last * 1e3, t[ PERF_FRAME ].max * 1e3,
+           t[ PERF_FRAME ].count, frames_per_second(),
+           t[ PERF_RENDER ].last * 1e3, t[ PERF_CURVES ].last * 1e3,
+           t[ PERF_COMPOSE ].last * 1e3,
+           t[ PERF_PARSE ].last * 1e3, t[ PERF_DERIV ].last * 1e3,
+           t[ PERF_COMPILE ].last * 1e3,
+           points_per_second() * 1e-6,
+           percent (counters[ PERF_CULLED ], looked_at),
+           percent (counters[ PERF_GRID_HITS ], grid_uses));
+  return buf;
+}
+
+void
+Perf::dump_csv (FILE *f) const
+{
+  fprintf (f, "at");
+  for (int t = 0; t < NUM_PERF_TIMERS; t++)
+    fprintf (f, ",%s_ms", timer_names[t]);
+  for (int c = 0; c < NUM_PERF_COUNTERS; c++)
+    fprintf (f, ",%s", counter_names[c]);
+  fprintf (f, "\n");
+
+  for (int i = 0; i < frames.size(); i++)
+  {
+    fprintf (f, "%.6f", frames[i].at);
+    for (int t = 0; t < NUM_PERF_TIMERS; t++)
+      fprintf (f, ",%.4f", frames[i].seconds[t] * 1e3);
+    for (int c = 0; c < NUM_PERF_COUNTERS; c++)
+      fprintf (f, ",%ld", frames[i].counts[c]);
+    fprintf (f, "\n");
+  }
+}
+
+void
+Perf::dump_json (FILE *f) const
+{
+  fprintf (f, "{\n  \"session_seconds\": %.3f,\n", now() - started);
+  fprintf (f, "  \"points_per_second\": %.0f,\n", points_per_second());
+
+  fprintf (f, "  \"timers\": {\n");
+  for (int t = 0; t < NUM_PERF_TIMERS; t++)
+  {
+    const Timer& timer = timers[t];
+    fprintf (f, "    \"%s\": { \"count\": %d, \"last_ms\": %.4f, "
+             "\"max_ms\": %.4f, \"total_ms\": %.4f }%s\n",
+             timer_names[t], timer.count, timer.last * 1e3,
+             timer.max * 1e3, timer.total * 1e3,
+             (t + 1 < NUM_PERF_TIMERS) ? "," : "");
+  }
+  fprintf (f, "  },\n");
+
+  fprintf (f, "  \"counters\": {\n");
+  for (int c = 0; c < NUM_PERF_COUNTERS; c++)
+    fprintf (f, "    \"%s\": %ld%s\n", counter_names[c], counters[c],
+             (c + 1 < NUM_PERF_COUNTERS) ? "," : "");
+  fprintf (f, "  },\n");
+
+  fprintf (f, "  \"frames\": [");
+  for (int i = 0; i < frames.size(); i++)
+  {
+    fprintf (f, "%s\n    { \"at\": %.6f", i ? "," : "", frames[i].at);
+    for (int t = 0; t < NUM_PERF_TIMERS; t++)
+      if (frames[i].seconds[t] > 0.0)
+        fprintf (f, ", \"%s_ms\": %.4f", timer_names[t],
+                 frames[i].seconds[t] * 1e3);
+    for (int c = 0; c < NUM_PERF_COUNTERS; c++)
+      fprintf (f, ", \"%s\": %ld", counter_names[c], frames[i].counts[c]);
+    fprintf (f, " }");
+  }
+  fprintf (f, "\n  ]\n}\n");
+}
@@ -0,0 +1,97 @@
+#ifndef _PERF_H_
+#define _PERF_H_
+
+#include <stdio.h>
+#include <string>
+#include <deque>
+
+// the stages that are timed
+enum perf_timer_enum
+{
+  PERF_PARSE,      // the text into Functions
+  PERF_DERIV,      // the gradients the distance shader needs
+  PERF_COMPILE,    // the Functions into Programs
+  PERF_RENDER,     // render_implicit()
+  PERF_CURVES,     // render_explicit()
+  PERF_COMPOSE,    // the levels into colors, with the grid
+  PERF_FRAME,      // a whole redraw
+  NUM_PERF_TIMERS
+};
+
+// the events that are counted
+enum perf_counter_enum
+{
+  PERF_POINTS,          // pixels the equations were evaluated at
+  PERF_CULLED,          // pixels skipped because nothing could be drawn
+  PERF_GRID_HITS,       // compositions that reused the grid overlay
+  PERF_GRID_MISSES,     // and those that had to draw it again
+  NUM_PERF_COUNTERS
+};
+
+// How long each stage of a session took, and how often things happened.
+// Every timer keeps its last, longest and total time; end_frame() also
+// logs the frame's times and counts, for dump_csv() and dump_json().
+class Perf
+{
+public:
+  struct Timer
+  {
+    int count;
+    double last, max, total;   // seconds
+  };
+
+  struct Frame
+  {
+    double at;                               // since the session began
+    double seconds[ NUM_PERF_TIMERS ];       // 0 if not run this frame
+    long counts[ NUM_PERF_COUNTERS ];        // during the frame
+  };
+
+  // frames kept in the log; the oldest go first
+  static const int MAX_FRAMES = 10000;
+
+private:
+  double started;
+  double running[ NUM_PERF_TIMERS ];     // when start() was called
+  Timer timers[ NUM_PERF_TIMERS ];
+  long counters[ NUM_PERF_COUNTERS ];
+  Frame frame;                           // the one under way
+  std::deque< Frame > frames;
+
+public:
+  Perf (void);
+
+  // seconds since some fixed time
+  static double now (void);
+
+  void start (perf_timer_enum t) { running[t] = now(); }
+  void stop  (perf_timer_enum t);
+
+  void count (perf_counter_enum c, long n = 1)
+  {
+    counters[c] += n;
+    frame.counts[c] += n;
+  }
+
+  void end_frame (void);
+
+  const Timer& get_timer (perf_timer_enum t) const { return timers[t]; }
+  long get_count (perf_counter_enum c) const { return counters[c]; }
+
+  // points per second of render_implicit(), over the whole session
+  double points_per_second (void) const;
+
+  // frames ended in the last 'window' seconds, per second; what an
+  // animation achieves
+  double frames_per_second (double window = 1.0) const;
+
+  // a few lines for an on-screen display
+  std::string summary (void) const;
+
+  // the frame log, a line per frame with a header, or as a JSON object
+  // with the totals too
+  void dump_csv  (FILE *f) const;
+  void dump_json (FILE *f) const;
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include "pixels.h"
+#include "render.h"
+#include <string.h>
+#include <algorithm>
+
+using namespace std;
+
+int
+pixel_format_size (pixel_format_enum format)
+{
+  return (format == PIXEL_RGB) ? 3 : 4;
+}
+
+// greys, the axes brightest
+static void
+default_grid (unsigned char grid[ NUM_GRID_CLASSES ][ 4 ])
+{
+  static const unsigned char greys[ NUM_GRID_CLASSES ] =
+    { 0x00, 0x40, 0x80, 0xB0 };
+
+  for (int c = 0; c < NUM_GRID_CLASSES; c++)
+  {
+    grid[c][0] = grid[c][1] = grid[c][2] = greys[c];
+    grid[c][3] = (c == GRID_NONE) ? 0 : 0xFF;
+  }
+}
+
+Colormap::Colormap (void)
+{
+  for (int i = 0; i < 256; i++)
+  {
+    rgba[i][0] = i;
+    rgba[i][1] = 0;
+    rgba[i][2] = 0;
+    rgba[i][3] = 0xFF;
+  }
+  default_grid (grid);
+}
+
+Colormap::Colormap (unsigned char r0, unsigned char g0, unsigned char b0,
+                    unsigned char r1, unsigned char g1, unsigned char b1)
+{
+  for (int i = 0; i < 256; i++)
+  {
+    rgba[i][0] = (r0 * (255 - i) + r1 * i + 127) / 255;
+    rgba[i][1] = (g0 * (255 - i) + g1 * i + 127) / 255;
+    rgba[i][2] = (b0 * (255 - i) + b1 * i + 127) / 255;
+    rgba[i][3] = i;
+  }
+  default_grid (grid);
+}
+
+static void
+pack (const unsigned char *c, pixel_format_enum format, unsigned char *p)
+{
+  switch (format)
+  {
+    case PIXEL_RGB:
+    case PIXEL_RGBA:
+      memcpy (p, c, 4);
+      break;
+    case PIXEL_BGRX:
+      p[0] = c[2];
+      p[1] = c[1];
+      p[2] = c[0];
+      p[3] = 0;
+      break;
+    case PIXEL_XRGB:
+      p[0] = 0;
+      p[1] = c[0];
+      p[2] = c[1];
+      p[3] = c[2];
+      break;
+    default:
+      break;
+  }
+}
+
+void
+write_pixels (const Canvas& levels, int x, int y, int width, int height,
+              const Colormap& colors, pixel_format_enum format,
+              unsigned char *dest, int dest_stride, const Canvas *overlay)
+{
+  int size = pixel_format_size (format);
+
+  // every level over every grid class as a finished pixel, so the row
+  // loop only copies
+  unsigned char packed[ NUM_GRID_CLASSES ][ 256 ][ 4 ];
+  int classes = overlay ? NUM_GRID_CLASSES : 1;
+  for (int g = 0; g < classes; g++)
+    for (int i = 0; i < 256; i++)
+    {
+      unsigned char c[4];
+      for (int k = 0; k < 4; k++)
+        c[k] = max (colors.rgba[i][k], colors.grid[g][k]);
+      pack (c, format, packed[g][i]);
+    }
+
+  for (int j = y; j < y + height; j++)
+  {
+    const unsigned char *src = levels.at (x, j);
+    unsigned char *d = dest + (j - levels.origin_y)*dest_stride +
+                       (x - levels.origin_x)*size;
+
+    // constant sizes, so the copies become single stores
+    if (overlay)
+    {
+      const unsigned char *ov = overlay->at (x, j);
+      for (int i = 0; i < width; i++, src += levels.pixel_size,
+                                       ov += overlay->pixel_size)
+        memcpy (d + size*i, packed[ *ov ][ *src ], size);
+    }
+    else if (size == 4)
+      for (int i = 0; i < width; i++, src += levels.pixel_size)
+        memcpy (d + 4*i, packed[0][ *src ], 4);
+    else
+      for (int i = 0; i < width; i++, src += levels.pixel_size)
+        memcpy (d + 3*i, packed[0][ *src ], 3);
+  }
+}
@@ -0,0 +1,47 @@
+#ifndef _PIXELS_H_
+#define _PIXELS_H_
+
+#include "render.h"
+#include "grid.h"
+
+// how whole pixels are laid out in memory, byte by byte
+enum pixel_format_enum
+{
+  PIXEL_RGB,    // Gdk::Pixbuf without alpha
+  PIXEL_RGBA,   // with alpha, for drawing over something else
+  PIXEL_BGRX,   // 32 bit X visuals on little endian machines
+  PIXEL_XRGB,   // and on big endian ones
+  NUM_PIXEL_FORMATS
+};
+
+int pixel_format_size (pixel_format_enum format);
+
+// the color of each shade level, 0 (far from every curve) to 255
+struct Colormap
+{
+  unsigned char rgba[ 256 ][ 4 ];
+  unsigned char grid[ NUM_GRID_CLASSES ][ 4 ];   // by grid_enum
+
+  // black to red, the original look
+  Colormap (void);
+
+  // from the background color to the curve color; with RGBA the
+  // background is transparent and the alpha is the level
+  Colormap (unsigned char r0, unsigned char g0, unsigned char b0,
+            unsigned char r1, unsigned char g1, unsigned char b1);
+};
+
+// The output stage: the levels of the rectangle (x, y, width, height) of
+// 'levels', one byte per pixel, become whole pixels of 'format' at the
+// same place in dest, which starts at the same view pixel as levels
+// (see Canvas). Every byte of every pixel is written, a row at a time
+// with sequential stores.
+//
+// With an overlay of grid_enum values (see render_grid()), each channel
+// is the brighter of the curve and the grid, so curves show through.
+void write_pixels (const Canvas& levels, int x, int y, int width, int height,
+                   const Colormap& colors, pixel_format_enum format,
+                   unsigned char *dest, int dest_stride,
+                   const Canvas *overlay = NULL);
+
+#endif
@@ -0,0 +1,214 @@
+#include "png_stream.h"
+#include "render.h"
+#include <png.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+using namespace Math;
+
+namespace {
+
+// one band: its shade levels, and the same as RGB rows for the encoder
+struct Band
+{
+  int y, height;
+  vector< unsigned char > levels;
+  vector< unsigned char > rgb;
+};
+
+// what the band thread needs
+struct BandJob
+{
+  const Program *prog, *y_prog;
+  const View *view;
+  int x, width;
+  const Shader *shader;
+  const Colormap *colors;
+  int num_threads;
+  Band *band;
+};
+
+void
+render_band (const BandJob& job)
+{
+  Band& b = *job.band;
+  const View& view = *job.view;
+
+  // the pixels of the whole view, so every one lands on the same point
+  // as without bands; the canvas starts at the band's first pixel
+  Canvas c;
+  c.buf = &b.levels[0];
+  c.stride = job.width;
+  c.pixel_size = 1;
+  c.origin_x = job.x;
+  c.origin_y = b.y;
+
+  render_implicit (*job.prog, view, c, job.x, b.y, job.width, b.height,
+                   *job.shader, PRECISION_AUTO, job.num_threads);
+  render_explicit (*job.y_prog, view, c, job.x, b.y, job.width, b.height);
+
+  write_pixels (c, job.x, b.y, job.width, b.height, *job.colors, PIXEL_RGB,
+                &b.rgb[0], job.width * 3);
+}
+
+void *
+band_thread (void *job)
+{
+  render_band (*(BandJob*) job);
+  return NULL;
+}
+
+// libpng reports errors by longjmp()ing back into stream()
+void
+png_error_fn (png_structp png, png_const_charp msg)
+{
+  fprintf (stderr, "png: %s\n", msg);
+  longjmp (png_jmpbuf (png), 1);
+}
+
+void
+append_fn (png_structp png, png_bytep data, png_size_t length)
+{
+  vector< unsigned char > *out =
+    (vector< unsigned char >*) png_get_io_ptr (png);
+  out->insert (out->end(), data, data + length);
+}
+
+// there is nothing buffered to flush
+void
+flush_fn (png_structp)
+{
+}
+
+// the rectangle (x, y, width, height) of view into f, or if that is
+// NULL, onto the end of out
+bool
+stream (FILE *f, vector< unsigned char > *out,
+        const Program& prog, const Program& y_prog, const View& view,
+        int x, int y, int width, int height,
+        const Shader& shader, const Colormap& colors,
+        int num_threads, int band_height)
+{
+  png_structp png = png_create_write_struct (PNG_LIBPNG_VER_STRING, NULL,
+                                             png_error_fn, NULL);
+  if (!png)
+    return false;
+
+  png_infop info = png_create_info_struct (png);
+  if (!info)
+  {
+    png_destroy_write_struct (&png, NULL);
+    return false;
+  }
+
+  Band bands[2];
+  for (int i = 0; i < 2; i++)
+  {
+    bands[i].levels.resize (width * band_height);
+    bands[i].rgb.resize (width * band_height * 3);
+  }
+
+  BandJob job;
+  job.prog = &prog;
+  job.y_prog = &y_prog;
+  job.view = &view;
+  job.x = x;
+  job.width = width;
+  job.shader = &shader;
+  job.colors = &colors;
+  job.num_threads = max (1, num_threads);
+
+  pthread_t thread;
+  volatile bool running = false;
+
+  if (setjmp (png_jmpbuf (png)))
+  {
+    if (running)
+      pthread_join (thread, NULL);
+    png_destroy_write_struct (&png, &info);
+    return false;
+  }
+
+  if (f)
+    png_init_io (png, f);
+  else
+    png_set_write_fn (png, out, append_fn, flush_fn);
+  png_set_IHDR (png, info, width, height, 8, PNG_COLOR_TYPE_RGB,
+                PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+                PNG_FILTER_TYPE_DEFAULT);
+
+  // mostly black, so fast settings lose little
+  png_set_compression_level (png, 3);
+  png_write_info (png, info);
+
+  bands[0].y = y;
+  bands[0].height = min (band_height, height);
+  job.band = &bands[0];
+  render_band (job);
+
+  for (int k = 0; bands[ k & 1 ].y < y + height; k++)
+  {
+    Band& cur  = bands[ k & 1 ];
+    Band& next = bands[ (k + 1) & 1 ];
+
+    // the next band renders while this one is compressed
+    next.y = cur.y + cur.height;
+    next.height = min (band_height, y + height - next.y);
+    if (next.height > 0)
+    {
+      job.band = &next;
+      if (pthread_create (&thread, NULL, band_thread, &job) == 0)
+        running = true;
+      else
+        render_band (job);
+    }
+
+    for (int j = 0; j < cur.height; j++)
+      png_write_row (png, &cur.rgb[ j * width * 3 ]);
+
+    if (running)
+    {
+      pthread_join (thread, NULL);
+      running = false;
+    }
+  }
+
+  png_write_end (png, info);
+  png_destroy_write_struct (&png, &info);
+
+  return !f || !ferror (f);
+}
+
+} // namespace
+
+bool
+stream_png (FILE *f, const Program& prog, const Program& y_prog,
+            const View& view, const Shader& shader, const Colormap& colors,
+            int num_threads, int band_height)
+{
+  return stream (f, NULL, prog, y_prog, view, 0, 0, view.width, view.height,
+                 shader, colors, num_threads, band_height);
+}
+
+bool
+stream_png (FILE *f, const Program& prog, const Program& y_prog,
+            const View& view, int x, int y, int width, int height,
+            const Shader& shader, const Colormap& colors,
+            int num_threads, int band_height)
+{
+  return stream (f, NULL, prog, y_prog, view, x, y, width, height,
+                 shader, colors, num_threads, band_height);
+}
+
+bool
+stream_png (vector< unsigned char >& out, const Program& prog,
+            const Program& y_prog, const View& view, const Shader& shader,
+            const Colormap& colors, int num_threads, int band_height)
+{
+  return stream (NULL, &out, prog, y_prog, view,
+                 0, 0, view.width, view.height,
+                 shader, colors, num_threads, band_height);
+}
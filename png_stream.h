@@ -0,0 +1,38 @@
+#ifndef _PNG_STREAM_H_
+#define _PNG_STREAM_H_
+
+#include <stdio.h>
+#include <vector>
+#include "program.h"
+#include "view.h"
+#include "shade.h"
+#include "pixels.h"
+
+#define BAND_HEIGHT 64
+
+// Renders prog (see compile_implicit()) and the explicit curves of y_prog
+// over view into a PNG file, band_height rows at a time. Each band is
+// encoded as soon as it is done while the next one renders, so there are
+// never more than two in memory and any size fits in
+// 2 * band_height * view.width * 4 bytes. Returns false if writing fails.
+bool stream_png (FILE *f, const Math::Program& prog,
+                 const Math::Program& y_prog, const View& view,
+                 const Shader& shader, const Colormap& colors,
+                 int num_threads, int band_height = BAND_HEIGHT);
+
+// only the rectangle (x, y, width, height) of view, such as one tile of a
+// bigger picture; every pixel is the one rendering all of view would give
+bool stream_png (FILE *f, const Math::Program& prog,
+                 const Math::Program& y_prog, const View& view,
+                 int x, int y, int width, int height,
+                 const Shader& shader, const Colormap& colors,
+                 int num_threads, int band_height = BAND_HEIGHT);
+
+// the whole view again, appending the file to out
+bool stream_png (std::vector< unsigned char >& out,
+                 const Math::Program& prog, const Math::Program& y_prog,
+                 const View& view, const Shader& shader,
+                 const Colormap& colors,
+                 int num_threads, int band_height = BAND_HEIGHT);
+
+#endif
@@ -0,0 +1,397 @@
+#include "program.h"
+#include "func.h"
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+using namespace std;
+
+namespace Math {
+
+const int Program::BATCH;
+
+bool
+Program::NodeKey::operator< (const NodeKey& other) const
+{
+  if (type != other.type) return type < other.type;
+  if (code != other.code) return code < other.code;
+  if (arg1 != other.arg1) return arg1 < other.arg1;
+  if (arg2 != other.arg2) return arg2 < other.arg2;
+
+  // compare the bits, so that NaNs can be keys too
+  return memcmp (&val, &other.val, sizeof (double)) < 0;
+}
+
+Program::Program (void)
+{
+  num_shared = 0;
+  fill (params, params + NUM_PARAMS, 0.0);
+
+  for (int i = 0; i <= NUM_DEPS; i++)
+    stage_begin[i] = 0;
+  for (int i = 0; i < NUM_DEPS; i++)
+    bound_begin[i] = 0;
+}
+
+Program::Program (const vector< Function >& funcs)
+{
+  num_shared = 0;
+  fill (params, params + NUM_PARAMS, 0.0);
+
+  for (int i = 0; i <= NUM_DEPS; i++)
+    stage_begin[i] = 0;
+  for (int i = 0; i < NUM_DEPS; i++)
+    bound_begin[i] = 0;
+
+  for (int i = 0; i < funcs.size(); i++)
+    add (funcs[i]);
+}
+
+int
+Program::intern (const Variant& v, int arg1, int arg2)
+{
+  NodeKey key;
+  key.type = (int)v.type;
+  key.code = 0;
+  key.val  = 0.0;
+
+  if (v.type == Variant::CONSTANT)
+    key.val = v.val;
+  else if (v.type == Variant::VARIABLE)
+    key.code = (int)v.var;
+  else
+  {
+    key.code = (int)v.op;
+
+    // a + b == b + a, and the same for a * b
+    if ((v.op == op_plus || v.op == op_mult) && arg2 < arg1)
+      swap (arg1, arg2);
+  }
+
+  key.arg1 = arg1;
+  key.arg2 = arg2;
+
+  map< NodeKey, int >::iterator it = node_map.find (key);
+  if (it != node_map.end())
+  {
+    num_shared++;
+    return it->second;
+  }
+
+  Node n;
+  n.v    = v;
+  n.arg1 = arg1;
+  n.arg2 = arg2;
+
+  if (v.type == Variant::VARIABLE)
+  {
+    n.deps  = is_param (v.var) ? DEP_NONE : 1 << (int)v.var;
+    n.bound = is_param (v.var);
+  }
+  else if (v.type == Variant::OP)
+  {
+    n.deps  = nodes[ arg1 ].deps | ((arg2 < 0) ? 0 : nodes[ arg2 ].deps);
+    n.bound = nodes[ arg1 ].bound || (arg2 >= 0 && nodes[ arg2 ].bound);
+  }
+  else
+  {
+    n.deps  = DEP_NONE;
+    n.bound = false;
+  }
+
+  nodes.push_back (n);
+
+  int id = nodes.size() - 1;
+  node_map[ key ] = id;
+
+  return id;
+}
+
+// folds constants, and drops operations whose result is known without
+// evaluating an argument. Only rewrites that give exactly what eval_op
+// would are done here (x + 0 is not x when x is -0).
+int
+Program::simplify (const Variant& v, int arg1, int arg2)
+{
+  bool const1 = (nodes[ arg1 ].v.type == Variant::CONSTANT);
+  bool const2 = (arg2 < 0 || nodes[ arg2 ].v.type == Variant::CONSTANT);
+
+  if (const1 && const2)
+  {
+    return intern (eval_op (v.op, nodes[ arg1 ].v.val,
+                            (arg2 < 0) ? 0.0 : nodes[ arg2 ].v.val), -1, -1);
+  }
+
+  double val1 = const1 ? nodes[ arg1 ].v.val : 1.0;
+  double val2 = (const2 && arg2 >= 0) ? nodes[ arg2 ].v.val : 1.0;
+
+  switch (v.op)
+  {
+    case op_mult:  // 0 * NaN == 0
+      if (val1 == 0.0 || val2 == 0.0)
+      {
+        return intern (0.0, -1, -1);
+      }
+      break;
+
+    case op_div:   // 0 / NaN == 0
+      if (const1 && val1 == 0.0)
+      {
+        return intern (0.0, -1, -1);
+      }
+      break;
+
+    case op_minus:
+      if (const2 && val2 == 0.0)
+        return arg1;
+      break;
+
+    case op_pow:
+      if (const2 && val2 == 1.0)
+        return arg1;
+      break;
+
+    default:
+      break;
+  }
+
+  return intern (v, arg1, arg2);
+}
+
+// drops the nodes no output needs anymore (simplify() can leave some
+// behind) and puts the rest in order of their deps, and within a stage
+// the ones depending on a parameter last. Since a node depends on at
+// least everything its arguments do, this is still an evaluation order.
+void
+Program::sort_nodes (void)
+{
+  vector< bool > live (nodes.size(), false);
+  for (int i = 0; i < outputs.size(); i++)
+    live[ outputs[i] ] = true;
+
+  for (int i = nodes.size() - 1; i >= 0; i--)
+  {
+    if (!live[i])
+      continue;
+    if (nodes[i].arg1 >= 0) live[ nodes[i].arg1 ] = true;
+    if (nodes[i].arg2 >= 0) live[ nodes[i].arg2 ] = true;
+  }
+
+  vector< int > order;
+  for (int deps = 0; deps < NUM_DEPS; deps++)
+  {
+    stage_begin[ deps ] = order.size();
+    for (int i = 0; i < nodes.size(); i++)
+      if (live[i] && nodes[i].deps == deps && !nodes[i].bound)
+        order.push_back (i);
+
+    bound_begin[ deps ] = order.size();
+    for (int i = 0; i < nodes.size(); i++)
+      if (live[i] && nodes[i].deps == deps && nodes[i].bound)
+        order.push_back (i);
+  }
+  stage_begin[ NUM_DEPS ] = order.size();
+
+  vector< int > new_id (nodes.size(), -1);
+  for (int i = 0; i < order.size(); i++)
+    new_id[ order[i] ] = i;
+
+  vector< Node > sorted (order.size());
+  for (int i = 0; i < order.size(); i++)
+  {
+    Node n = nodes[ order[i] ];
+    if (n.arg1 >= 0) n.arg1 = new_id[ n.arg1 ];
+    if (n.arg2 >= 0) n.arg2 = new_id[ n.arg2 ];
+    sorted[i] = n;
+  }
+  nodes.swap (sorted);
+
+  map< NodeKey, int > new_map;
+  map< NodeKey, int >::iterator it;
+  for (it = node_map.begin(); it != node_map.end(); it++)
+  {
+    if (!live[ it->second ])
+      continue;
+
+    NodeKey key = it->first;
+    if (key.arg1 >= 0) key.arg1 = new_id[ key.arg1 ];
+    if (key.arg2 >= 0) key.arg2 = new_id[ key.arg2 ];
+    new_map[ key ] = new_id[ it->second ];
+  }
+  node_map.swap (new_map);
+
+  for (int i = 0; i < outputs.size(); i++)
+    outputs[i] = new_id[ outputs[i] ];
+}
+
+int
+Program::add (const Function& f)
+{
+  vector< Variant > RPN = f.get_rpn_stack();
+  vector< int > node_stack;
+
+  for (int i = 0; i < RPN.size(); i++)
+  {
+    Variant cur = RPN[i];
+
+    if (cur.type != Variant::OP)
+      node_stack.push_back (intern (cur, -1, -1));
+    else if (cur.is_infix_op())
+    {
+      int arg2 = node_stack.back(); node_stack.pop_back();
+      int arg1 = node_stack.back(); node_stack.pop_back();
+      node_stack.push_back (simplify (cur, arg1, arg2));
+    }
+    else
+    {
+      int arg1 = node_stack.back(); node_stack.pop_back();
+      node_stack.push_back (simplify (cur, arg1, -1));
+    }
+  }
+
+  assert (node_stack.size() == 1);
+
+  outputs.push_back (node_stack.back());
+  sort_nodes();
+
+  return outputs.size() - 1;
+}
+
+template< class T >
+void
+Program::eval_nodes (int begin, int end,
+                     const T *var_values, T *regs) const
+{
+  for (int i = begin; i < end; i++)
+  {
+    const Node& n = nodes[i];
+
+    if (n.v.type == Variant::CONSTANT)
+      regs[i] = n.v.val;
+    else if (n.v.type == Variant::VARIABLE)
+      regs[i] = is_param (n.v.var) ? T (params[ n.v.var - NUM_VARS ])
+                                   : var_values[ (int)n.v.var ];
+    else
+      regs[i] = eval_op (n.v.op, regs[ n.arg1 ],
+                         (n.arg2 < 0) ? T (0.0) : regs[ n.arg2 ]);
+  }
+}
+
+template void Program::eval_nodes< double > (int, int, const double *,
+                                             double *) const;
+template void Program::eval_nodes< DoubleDouble > (int, int,
+                                                   const DoubleDouble *,
+                                                   DoubleDouble *) const;
+template void Program::eval_nodes< Interval > (int, int, const Interval *,
+                                               Interval *) const;
+
+static inline double power (double a, double b) { return pow (a, b); }
+static inline float  power (float a, float b)   { return powf (a, b); }
+
+static inline unary_func  unary (ops_enum op, double) 
+{ return get_unary_func (op); }
+static inline unary_funcf unary (ops_enum op, float)
+{ return get_unary_funcf (op); }
+
+template< class T >
+void
+Program::eval_batch (int begin, int end,
+                     const T *const *var_values, T *regs) const
+{
+  for (int i = begin; i < end; i++)
+  {
+    const Node& n = nodes[i];
+    T *r = regs + i * BATCH;
+
+    if (n.v.type == Variant::CONSTANT)
+    {
+      T val = (T)n.v.val;
+      for (int l = 0; l < BATCH; l++)
+        r[l] = val;
+      continue;
+    }
+
+    if (n.v.type == Variant::VARIABLE && is_param (n.v.var))
+    {
+      T val = (T)params[ n.v.var - NUM_VARS ];
+      for (int l = 0; l < BATCH; l++)
+        r[l] = val;
+      continue;
+    }
+
+    if (n.v.type == Variant::VARIABLE)
+    {
+      copy (var_values[ (int)n.v.var ], var_values[ (int)n.v.var ] + BATCH, r);
+      continue;
+    }
+
+    const T *a = regs + n.arg1 * BATCH;
+    const T *b = regs + n.arg2 * BATCH;   // only read for infix ops
+
+    // the same as eval_op, one operation at a time
+    switch (n.v.op)
+    {
+      case op_plus:
+        for (int l = 0; l < BATCH; l++)
+          r[l] = a[l] + b[l];
+        break;
+
+      case op_minus:
+        for (int l = 0; l < BATCH; l++)
+          r[l] = a[l] - b[l];
+        break;
+
+      case op_mult:
+        for (int l = 0; l < BATCH; l++)
+          r[l] = (a[l] == 0 || b[l] == 0) ? 0 : a[l] * b[l];
+        break;
+
+      case op_div:
+        for (int l = 0; l < BATCH; l++)
+          r[l] = (a[l] == 0) ? 0 : a[l] / b[l];
+        break;
+
+      case op_pow:
+        for (int l = 0; l < BATCH; l++)
+          r[l] = power (a[l], b[l]);
+        break;
+
+      default:
+        {
+          T (*f)(T) = unary (n.v.op, (T)0);
+          for (int l = 0; l < BATCH; l++)
+            r[l] = f (a[l]);
+        }
+        break;
+    }
+  }
+}
+
+template void Program::eval_batch< double >
+  (int begin, int end, const double *const *var_values, double *regs) const;
+template void Program::eval_batch< float >
+  (int begin, int end, const float *const *var_values, float *regs) const;
+
+vector< var_enum >
+Program::get_params (void) const
+{
+  vector< var_enum > found;
+  for (int i = get_stage_begin (DEP_NONE); i < get_stage_end (DEP_NONE); i++)
+    if (nodes[i].v.type == Variant::VARIABLE)
+      found.push_back (nodes[i].v.var);
+
+  sort (found.begin(), found.end());
+  return found;
+}
+
+void
+Program::get_outputs (const double *regs, double *out) const
+{
+  for (int i = 0; i < outputs.size(); i++)
+    out[i] = regs[ outputs[i] ];
+}
+
+} // namespace Math
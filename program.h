@@ -0,0 +1,146 @@
+#ifndef _PROGRAM_H_
+#define _PROGRAM_H_
+
+#include <vector>
+#include <map>
+#include "func.h"
+#include "dd.h"
+#include "interval.h"
+
+namespace Math
+{
+  // which variables a node depends on
+  enum deps_enum
+  {
+    DEP_NONE = 0,
+    DEP_X    = 1 << var_x,
+    DEP_Y    = 1 << var_y,
+    DEP_XY   = DEP_X | DEP_Y,
+    NUM_DEPS
+  };
+
+  // Several Functions compiled into one DAG. Identical subexpressions,
+  // within one function or across all of them, become a single node, so
+  // one evaluation produces every output and computes e.g. the sin(x) of
+  // "y = sin(x) + 1; y = sin(x) + 2" only once.
+  //
+  // Constant subexpressions are folded, and the nodes are kept sorted by
+  // the variables they depend on, so that each class can be evaluated on
+  // its own: the x-only nodes once per column, the y-only nodes once per
+  // row, and only the rest per point.
+  //
+  // Parameters are not folded, but count as DEP_NONE: they take the
+  // values last bound with bind(), read whenever the DEP_NONE nodes are
+  // evaluated, i.e. once per frame. Rebinding needs no recompiling.
+  // Within each stage the nodes depending on a parameter come last, so
+  // that when only the parameters change, the rest of an x-only or
+  // y-only stage can be kept from the frame before.
+  class Program
+  {
+  public:
+    // points evaluated together by eval_batch()
+    static const int BATCH = 64;
+
+    struct Node
+    {
+      Variant v;
+      int arg1, arg2;   // argument nodes, -1 if unused
+      int deps;         // deps_enum
+      bool bound;       // depends on a parameter
+    };
+
+  private:
+    struct NodeKey
+    {
+      int type, code, arg1, arg2;
+      double val;
+
+      bool operator< (const NodeKey& other) const;
+    };
+
+    std::vector< Node > nodes;     // in evaluation order
+    std::vector< int >  outputs;   // node of each added function
+    std::map< NodeKey, int > node_map;
+
+    int stage_begin[ NUM_DEPS + 1 ];
+    int bound_begin[ NUM_DEPS ];   // the first node of each stage that
+                                   // depends on a parameter
+
+    int num_shared;   // RPN elements that reused an existing node
+
+    double params[ NUM_PARAMS ];   // the values bound, by parameter
+
+    int intern (const Variant& v, int arg1, int arg2);
+    int simplify (const Variant& v, int arg1, int arg2);
+    void sort_nodes (void);
+
+    // in double, DoubleDouble or Interval
+    template< class T >
+    void eval_nodes (int begin, int end,
+                     const T *var_values, T *regs) const;
+
+  public:
+    Program (void);
+    Program (const std::vector< Function >& funcs);
+
+    // returns the output index of f
+    int add (const Function& f);
+
+    int get_num_outputs (void) const { return outputs.size(); }
+    int get_num_nodes   (void) const { return nodes.size(); }
+    int get_num_shared  (void) const { return num_shared; }
+
+    // the nodes depending on exactly 'deps' are [begin, end)
+    int get_stage_begin (int deps) const { return stage_begin[ deps ]; }
+    int get_stage_end   (int deps) const { return stage_begin[ deps + 1 ]; }
+    int get_bound_begin (int deps) const { return bound_begin[ deps ]; }
+    int get_output_deps (int i) const { return nodes[ outputs[i] ].deps; }
+    int get_output_node (int i) const { return outputs[i]; }
+    const Node& get_node (int i) const { return nodes[i]; }
+
+    // the parameters any output depends on, in order; each is 0 until
+    // bound. Bind between evaluations, not during one.
+    std::vector< var_enum > get_params (void) const;
+    void bind (var_enum param, double val)
+    { params[ param - NUM_VARS ] = val; }
+    double get_binding (var_enum param) const
+    { return params[ param - NUM_VARS ]; }
+
+    // evaluates only the nodes depending on exactly 'deps'; the nodes of
+    // every subset of 'deps' must already be in regs. var_values holds
+    // x and y; the parameters come from bind(). T is double,
+    // DoubleDouble for views zoomed in too far for double, or Interval
+    // to bound the outputs over a box.
+    template< class T >
+    void eval_stage (int deps, const T *var_values, T *regs) const
+    { eval_nodes (get_stage_begin (deps), get_stage_end (deps),
+                  var_values, regs); }
+
+    // only the nodes of the stage that depend on a parameter; regs must
+    // hold the rest of the stage too
+    template< class T >
+    void eval_bound (int deps, const T *var_values, T *regs) const
+    { eval_nodes (get_bound_begin (deps), get_stage_end (deps),
+                  var_values, regs); }
+
+    void get_outputs (const double *regs, double *out) const;
+
+    // nodes [begin, end) for BATCH points at once, in double or float.
+    // Node i's values are at regs + i * BATCH, and variable v's values at
+    // var_values[v]. Each operation is a loop over the points, which the
+    // compiler can vectorize; twice as many floats fit in a register.
+    template< class T >
+    void eval_batch (int begin, int end,
+                     const T *const *var_values, T *regs) const;
+
+    // regs must hold get_num_nodes() doubles, out get_num_outputs()
+    void operator() (const double *var_values,
+                     double *regs, double *out) const
+    {
+      eval_nodes (0, nodes.size(), var_values, regs);
+      get_outputs (regs, out);
+    }
+  };
+}
+
+#endif
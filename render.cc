@@ -0,0 +1,743 @@
+#include "render.h"
+#include "program.h"
+#include "view.h"
+#include <math.h>
+#include <float.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <vector>
+#include <deque>
+#include <algorithm>
+
+using namespace std;
+using namespace Math;
+
+// float has 24 bits; keep at least 6 of them below the pixel spacing
+static bool
+float_is_enough (const View& view, int x, int y, int width, int height)
+{
+  double max_x = max (fabs (view.horiz_px_to_pt (x)),
+                      fabs (view.horiz_px_to_pt (x + width)));
+  double max_y = max (fabs (view.vert_px_to_pt (y)),
+                      fabs (view.vert_px_to_pt (y + height)));
+
+  return max (max_x, max_y) * view.scale < (1 << 18);
+}
+
+// the same for double's 53 bits; past this, pixels run together and the
+// tile is evaluated in double-double
+static bool
+double_is_enough (const View& view, int x, int y, int width, int height)
+{
+  double max_x = max (fabs (view.horiz_px_to_pt (x)),
+                      fabs (view.horiz_px_to_pt (x + width)));
+  double max_y = max (fabs (view.vert_px_to_pt (y)),
+                      fabs (view.vert_px_to_pt (y + height)));
+
+  return max (max_x, max_y) * view.scale < ldexp (1.0, 46);
+}
+
+// float holds integers exactly only up to 2^24, and nothing nonzero
+// below FLT_MIN. A constant or parameter out of that range, like the
+// 100000000 of "x + 100000000 = y", rounds away the differences between
+// pixels however small the coordinates are.
+static bool
+float_holds_consts (const vector< double >& consts)
+{
+  for (int k = 0; k < consts.size(); k++)
+  {
+    double c = fabs (consts[k]);
+    if (c > (1 << 24) || (c != 0.0 && c < FLT_MIN))
+      return false;
+  }
+  return true;
+}
+
+// the point at a pixel, as center + offset with nothing rounded away
+static DoubleDouble
+horiz_px_to_dd (const View& view, double i)
+{ return two_sum (view.center_x, (i - view.width/2) / view.scale); }
+
+static DoubleDouble
+vert_px_to_dd (const View& view, double j)
+{ return two_sum (view.center_y, (view.height/2 - j) / view.scale); }
+
+vector< Function >
+implicit_functions (const vector< Function >& F, const Shader& shader)
+{
+  if (!shader.uses_distance())
+    return F;
+
+  vector< Function > funcs;
+  for (int i = 0; i < F.size(); i++)
+  {
+    funcs.push_back (F[i]);
+    funcs.push_back (F[i].differentiate (var_x));
+    funcs.push_back (F[i].differentiate (var_y));
+  }
+
+  return funcs;
+}
+
+Program
+compile_implicit (const vector< Function >& F, const Shader& shader)
+{
+  return Program (implicit_functions (F, shader));
+}
+
+// what the shader takes for one equation: |F|, or the distance to the
+// curve in pixels, to first order
+template< class T >
+static inline T
+shader_input (bool distance, T scale, T f, T f_x, T f_y)
+{
+  if (!distance)
+    return fabs (f);
+
+  return fabs (f) * scale / sqrt (f_x*f_x + f_y*f_y);
+}
+
+// one tile, Program::BATCH pixels of a row at a time, so the levels go
+// out with sequential stores. The hoisted values are always computed in
+// double, and only rounded here.
+template< class T >
+static void
+render_tile (const Program& prog, const Hoisted& h, const Canvas& c,
+             const Shader& shader, double scale,
+             int tile_x, int tile_y, int tile_width, int tile_height,
+             vector< T >& regs)
+{
+  const int B = Program::BATCH;
+
+  int mixed_begin = prog.get_stage_begin (DEP_XY);
+  int mixed_end   = prog.get_stage_end (DEP_XY);
+
+  bool distance = shader.uses_distance();
+  int  per_eq   = distance ? 3 : 1;
+  int  num_eq   = prog.get_num_outputs() / per_eq;
+
+  T diff[ B ];
+  unsigned char shades[ B ];
+
+  for (int k = 0; k < h.consts.size(); k++)
+    fill (&regs[ k * B ], &regs[ k * B ] + B, (T)h.consts[k]);
+
+  for (int j = tile_y; j < tile_y + tile_height; j++)
+  {
+    // the same for the whole row
+    for (int k = 0; k < h.num_y; k++)
+      fill (&regs[ (h.y_begin + k) * B ], &regs[ (h.y_begin + k) * B ] + B,
+            (T)h.y_cache[ k * h.height + j - h.y ]);
+
+    for (int i0 = tile_x; i0 < tile_x + tile_width; i0 += B)
+    {
+      int n = min (B, tile_x + tile_width - i0);
+
+      for (int k = 0; k < h.num_x; k++)
+      {
+        const double *src = &h.x_cache[ k * h.width + i0 - h.x ];
+        T *dest = &regs[ (h.x_begin + k) * B ];
+        for (int l = 0; l < n; l++)
+          dest[l] = (T)src[l];
+      }
+
+      // the variables themselves are x-only or y-only nodes
+      prog.eval_batch< T > (mixed_begin, mixed_end, NULL, &regs[0]);
+
+      // keep the closest of the equations
+      for (int k = 0; k < num_eq; k++)
+      {
+        const T *f   = &regs[ prog.get_output_node (k * per_eq) * B ];
+        const T *f_x = distance ?
+          &regs[ prog.get_output_node (k * per_eq + 1) * B ] : f;
+        const T *f_y = distance ?
+          &regs[ prog.get_output_node (k * per_eq + 2) * B ] : f;
+
+        for (int l = 0; l < n; l++)
+        {
+          T d = shader_input (distance, (T)scale, f[l], f_x[l], f_y[l]);
+          diff[l] = (k == 0 || d < diff[l]) ? d : diff[l];
+        }
+      }
+
+      unsigned char *dest = c.at (i0, j);
+      if (c.pixel_size == 1)
+        shader.quantize (diff, n, dest);
+      else
+      {
+        shader.quantize (diff, n, shades);
+        for (int l = 0; l < n; l++)
+          dest[ l*c.pixel_size ] = shades[l];
+      }
+    }
+  }
+}
+
+// a tile too deep for double: the coordinates are center + offset in
+// double-double, and so is everything computed from them. About 20
+// times slower per pixel, so only used where it makes a difference.
+static void
+render_tile_dd (const Program& prog, const View& view, const Canvas& c,
+                const Shader& shader,
+                int tile_x, int tile_y, int tile_width, int tile_height)
+{
+  bool distance = shader.uses_distance();
+  int  per_eq   = distance ? 3 : 1;
+  int  num_eq   = prog.get_num_outputs() / per_eq;
+
+  int x_begin = prog.get_stage_begin (DEP_X);
+  int num_x   = prog.get_stage_end (DEP_X) - x_begin;
+
+  DoubleDouble x_y[2];
+  vector< DoubleDouble > regs (prog.get_num_nodes());
+  vector< DoubleDouble > x_cache (tile_width * num_x);
+
+  prog.eval_stage (DEP_NONE, x_y, &regs[0]);
+
+  for (int i = 0; i < tile_width; i++)
+  {
+    x_y[0] = horiz_px_to_dd (view, tile_x + i);
+    prog.eval_stage (DEP_X, x_y, &regs[0]);
+    copy (regs.begin() + x_begin, regs.begin() + x_begin + num_x,
+          x_cache.begin() + i * num_x);
+  }
+
+  for (int j = tile_y; j < tile_y + tile_height; j++)
+  {
+    x_y[1] = vert_px_to_dd (view, j);
+    prog.eval_stage (DEP_Y, x_y, &regs[0]);
+
+    for (int i = 0; i < tile_width; i++)
+    {
+      copy (x_cache.begin() + i * num_x, x_cache.begin() + (i + 1) * num_x,
+            regs.begin() + x_begin);
+      prog.eval_stage (DEP_XY, x_y, &regs[0]);
+
+      // the values are only rounded to double once they are final
+      double diff = HUGE_VAL;
+      for (int k = 0; k < num_eq; k++)
+      {
+        double f = regs[ prog.get_output_node (k * per_eq) ].to_double();
+        double d = fabs (f);
+        if (distance)
+          d = shader_input (true, view.scale, f,
+                regs[ prog.get_output_node (k * per_eq + 1) ].to_double(),
+                regs[ prog.get_output_node (k * per_eq + 2) ].to_double());
+        diff = min (diff, d);
+      }
+
+      *c.at (tile_x + i, j) = shader (diff);
+    }
+  }
+}
+
+#define TILE_SIZE 64
+
+// what the threads of render_implicit() share. Each takes the next tile
+// until there are none left; tiles never overlap, so only the counter
+// needs the lock.
+struct TileQueue
+{
+  const Program *prog;
+  const View *view;
+  const Canvas *c;
+  const Shader *shader;
+  precision_enum precision;
+  const Hoisted *h;
+
+  int tiles_x, num_tiles;
+  int next;
+  pthread_mutex_t lock;
+
+  int helping;   // pool threads working on it; needs the pool's lock
+};
+
+static void
+render_tiles (TileQueue& q)
+{
+  const Program& prog = *q.prog;
+  const View& view = *q.view;
+  const Hoisted& h = *q.h;
+
+  vector< float >  regs_f (prog.get_num_nodes() * Program::BATCH);
+  vector< double > regs_d (prog.get_num_nodes() * Program::BATCH);
+
+  for (;;)
+  {
+    pthread_mutex_lock (&q.lock);
+    int t = q.next++;
+    pthread_mutex_unlock (&q.lock);
+
+    if (t >= q.num_tiles)
+      break;
+
+    int tx = h.x + (t % q.tiles_x) * TILE_SIZE;
+    int ty = h.y + (t / q.tiles_x) * TILE_SIZE;
+    int tw = min (TILE_SIZE, h.x + h.width - tx);
+    int th = min (TILE_SIZE, h.y + h.height - ty);
+
+    if (!double_is_enough (view, tx, ty, tw, th))
+      render_tile_dd (prog, view, *q.c, *q.shader, tx, ty, tw, th);
+    else if (q.precision == PRECISION_AUTO &&
+             float_is_enough (view, tx, ty, tw, th))
+      render_tile (prog, h, *q.c, *q.shader, view.scale,
+                   tx, ty, tw, th, regs_f);
+    else
+      render_tile (prog, h, *q.c, *q.shader, view.scale,
+                   tx, ty, tw, th, regs_d);
+  }
+}
+
+int
+default_num_threads (void)
+{
+  long n = sysconf (_SC_NPROCESSORS_ONLN);
+  return (n < 1) ? 1 : (int) n;
+}
+
+// The threads that help render_implicit(), started with the first call
+// that wants them and kept for every call after, from whatever thread
+// and for whatever window: one per processor but the caller's, however
+// many callers there are, and none started or joined per frame. A call
+// asks for help by queueing its tiles once for each thread it wants;
+// the threads take the oldest first.
+struct Pool
+{
+  pthread_mutex_t lock;
+  pthread_cond_t work, done;
+  deque< TileQueue* > wanted;
+  int num_threads;
+};
+
+static Pool pool;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+static void *
+pool_thread (void *)
+{
+  pthread_mutex_lock (&pool.lock);
+  for (;;)
+  {
+    while (pool.wanted.empty())
+      pthread_cond_wait (&pool.work, &pool.lock);
+
+    TileQueue *q = pool.wanted.front();
+    pool.wanted.pop_front();
+    q->helping++;
+    pthread_mutex_unlock (&pool.lock);
+
+    render_tiles (*q);
+
+    pthread_mutex_lock (&pool.lock);
+    q->helping--;
+    pthread_cond_broadcast (&pool.done);
+  }
+  return NULL;
+}
+
+static void
+start_pool (void)
+{
+  pthread_mutex_init (&pool.lock, NULL);
+  pthread_cond_init (&pool.work, NULL);
+  pthread_cond_init (&pool.done, NULL);
+
+  pool.num_threads = 0;
+  for (int i = 0; i < default_num_threads() - 1; i++)
+  {
+    pthread_t tid;
+    pthread_attr_t attr;
+    pthread_attr_init (&attr);
+    pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create (&tid, &attr, pool_thread, NULL) == 0)
+      pool.num_threads++;
+    pthread_attr_destroy (&attr);
+  }
+}
+
+// renders q's tiles with up to num_threads threads, this one included
+static void
+render_pooled (TileQueue& q, int num_threads)
+{
+  pthread_once (&pool_once, start_pool);
+
+  q.helping = 0;
+  int helpers = min (num_threads - 1, pool.num_threads);
+  if (helpers > 0)
+  {
+    pthread_mutex_lock (&pool.lock);
+    for (int i = 0; i < helpers; i++)
+      pool.wanted.push_back (&q);
+    pthread_cond_broadcast (&pool.work);
+    pthread_mutex_unlock (&pool.lock);
+  }
+
+  render_tiles (q);
+
+  if (helpers > 0)
+  {
+    // every tile is taken; the threads that haven't got to q yet needn't
+    // bother, and those that have are finishing their last tiles
+    pthread_mutex_lock (&pool.lock);
+    pool.wanted.erase (remove (pool.wanted.begin(), pool.wanted.end(), &q),
+                       pool.wanted.end());
+    while (q.helping > 0)
+      pthread_cond_wait (&pool.done, &pool.lock);
+    pthread_mutex_unlock (&pool.lock);
+  }
+}
+
+void
+render_implicit (const Program& prog, const View& view, const Canvas& c,
+                 int x, int y, int width, int height,
+                 const Shader& shader, precision_enum precision,
+                 int num_threads, Hoisted *hoisted)
+{
+  if (prog.get_num_outputs() == 0)
+  { // nothing to test at every pixel
+    for (int j = y; j < y + height; j++)
+      for (int i = x; i < x + width; i++)
+        *c.at (i, j) = 0;
+    return;
+  }
+
+  double x_y[2];
+  vector< double > regs (prog.get_num_nodes());
+
+  Hoisted local;
+  Hoisted& h = hoisted ? *hoisted : local;
+
+  // the x-only parts of the equations only change from column to column,
+  // and the y-only parts from row to row, so do those once per column/row.
+  // Kept from the last call, only the parts depending on a parameter are
+  // done again.
+  bool keep = h.prog == &prog && h.num_nodes == prog.get_num_nodes() &&
+              h.x == x && h.y == y && h.width == width &&
+              h.height == height && h.view.width == view.width &&
+              h.view.height == view.height && h.view.scale == view.scale &&
+              h.view.center_x == view.center_x &&
+              h.view.center_y == view.center_y;
+
+  h.prog = &prog;
+  h.num_nodes = prog.get_num_nodes();
+  h.view = view;
+  h.x = x;
+  h.y = y;
+  h.width = width;
+  h.height = height;
+  h.x_begin = prog.get_stage_begin (DEP_X);
+  h.num_x   = prog.get_stage_end (DEP_X) - h.x_begin;
+  h.y_begin = prog.get_stage_begin (DEP_Y);
+  h.num_y   = prog.get_stage_end (DEP_Y) - h.y_begin;
+
+  prog.eval_stage (DEP_NONE, x_y, &regs[0]);
+  h.consts.assign (regs.begin(), regs.begin() + prog.get_stage_end (DEP_NONE));
+
+  // from the first node to do again on, relative to the stage
+  int x_from = keep ? prog.get_bound_begin (DEP_X) - h.x_begin : 0;
+  int y_from = keep ? prog.get_bound_begin (DEP_Y) - h.y_begin : 0;
+
+  h.x_cache.resize (width * h.num_x);
+  for (int i = x; i < x + width && x_from < h.num_x; i++)
+  {
+    for (int k = 0; k < x_from; k++)
+      regs[ h.x_begin + k ] = h.x_cache[ k * width + i - x ];
+
+    x_y[0] = view.horiz_px_to_pt (i);
+    if (keep)
+      prog.eval_bound (DEP_X, x_y, &regs[0]);
+    else
+      prog.eval_stage (DEP_X, x_y, &regs[0]);
+
+    for (int k = x_from; k < h.num_x; k++)
+      h.x_cache[ k * width + i - x ] = regs[ h.x_begin + k ];
+  }
+
+  h.y_cache.resize (height * h.num_y);
+  for (int j = y; j < y + height && y_from < h.num_y; j++)
+  {
+    for (int k = 0; k < y_from; k++)
+      regs[ h.y_begin + k ] = h.y_cache[ k * height + j - y ];
+
+    x_y[1] = view.vert_px_to_pt (j);
+    if (keep)
+      prog.eval_bound (DEP_Y, x_y, &regs[0]);
+    else
+      prog.eval_stage (DEP_Y, x_y, &regs[0]);
+
+    for (int k = y_from; k < h.num_y; k++)
+      h.y_cache[ k * height + j - y ] = regs[ h.y_begin + k ];
+  }
+
+  TileQueue q;
+  q.prog = &prog;
+  q.view = &view;
+  q.c = &c;
+  q.shader = &shader;
+  q.precision = float_holds_consts (h.consts) ? precision :
+                                                PRECISION_DOUBLE;
+  q.h = &h;
+  q.tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+  q.num_tiles = q.tiles_x * ((height + TILE_SIZE - 1) / TILE_SIZE);
+  q.next = 0;
+  pthread_mutex_init (&q.lock, NULL);
+
+  // no more threads than tiles; this one is one of them
+  render_pooled (q, max (1, min (num_threads, q.num_tiles)));
+
+  pthread_mutex_destroy (&q.lock);
+}
+
+// the bounds of each output of prog over the box
+static void
+bound_outputs (const Program& prog, const Interval& x, const Interval& y,
+               vector< Interval >& out)
+{
+  out.clear();
+  if (prog.get_num_outputs() == 0)
+    return;
+
+  Interval x_y[2] = { x, y };
+  vector< Interval > regs (prog.get_num_nodes());
+  for (int deps = 0; deps < NUM_DEPS; deps++)
+    prog.eval_stage (deps, x_y, &regs[0]);
+
+  out.resize (prog.get_num_outputs());
+  for (int k = 0; k < out.size(); k++)
+    out[k] = regs[ prog.get_output_node (k) ];
+}
+
+// the points between two pixel coordinates, rounded outwards: at deep
+// zoom a pixel is smaller than the rounding of the coordinates, and the
+// renderers place it exactly
+static Interval
+px_span (double a, double b)
+{
+  double lo = min (a, b), hi = max (a, b);
+  return Interval (lo - fabs (lo) * DBL_EPSILON, hi + fabs (hi) * DBL_EPSILON);
+}
+
+bool
+view_is_empty (const Program& prog, const Program& y_prog,
+               const View& view, int x, int y, int width, int height,
+               const Shader& shader)
+{
+  vector< Interval > out;
+
+  // a pixel is drawn for its center, so a margin of a pixel is plenty
+  Interval box_x = px_span (view.horiz_px_to_pt (x - 1),
+                            view.horiz_px_to_pt (x + width));
+  Interval box_y = px_span (view.vert_px_to_pt (y + height),
+                            view.vert_px_to_pt (y - 1));
+
+  if (prog.get_num_outputs() > 0)
+  {
+    if (shader.uses_distance())
+      return false;
+
+    double range = shader.get_range();
+    bound_outputs (prog, box_x, box_y, out);
+    for (int k = 0; k < out.size(); k++)
+      if (!out[k].is_empty() && out[k].lo < range && out[k].hi > -range)
+        return false;
+  }
+
+  // the anti-aliased curves reach a pixel past their rows, and their
+  // segments start a column outside
+  Interval curve_x = px_span (view.horiz_px_to_pt (x - 2),
+                              view.horiz_px_to_pt (x + width + 1));
+  Interval rows = px_span (view.vert_px_to_pt (y + height + 2),
+                           view.vert_px_to_pt (y - 2));
+
+  bound_outputs (y_prog, curve_x, Interval (0.0), out);
+  for (int k = 0; k < out.size(); k++)
+    if (!out[k].is_empty() && out[k].lo <= rows.hi && out[k].hi >= rows.lo)
+      return false;
+
+  return true;
+}
+
+struct curve_canvas
+{
+  Canvas canvas;
+  int x0, y0, x1, y1;   // clip rectangle [x0, x1) x [y0, y1)
+};
+
+static void
+plot (const curve_canvas& c, int i, int j, double intensity)
+{
+  if (i < c.x0 || i >= c.x1 || j < c.y0 || j >= c.y1)
+    return;
+
+  unsigned char& px  = *c.canvas.at (i, j);
+  unsigned char  val = (unsigned char) (intensity * 0xFF);
+  if (val > px)
+    px = val;
+}
+
+// anti-aliased (Wu) line; pixel (i, j) is centered on (i, j)
+static void
+draw_aa_line (const curve_canvas& c, double x0, double y0,
+              double x1, double y1)
+{
+  bool steep = fabs (y1 - y0) > fabs (x1 - x0);
+  if (steep)
+  {
+    swap (x0, y0);
+    swap (x1, y1);
+  }
+  if (x0 > x1)
+  {
+    swap (x0, x1);
+    swap (y0, y1);
+  }
+
+  double gradient = (x1 == x0) ? 0.0 : (y1 - y0) / (x1 - x0);
+
+  int start = (int) floor (x0 + 0.5);
+  int end   = (int) floor (x1 + 0.5);
+  for (int i = start; i <= end; i++)
+  {
+    double pos  = y0 + gradient * (i - x0);
+    int    j    = (int) floor (pos);
+    double frac = pos - j;
+
+    if (steep)
+    {
+      plot (c, j,     i, 1.0 - frac);
+      plot (c, j + 1, i, frac);
+    }
+    else
+    {
+      plot (c, i, j,     1.0 - frac);
+      plot (c, i, j + 1, frac);
+    }
+  }
+}
+
+// evaluates the y = Y(x) curves at a column, in double or, when the view
+// is too deep for it, in double-double; rows come back in pixels
+class curve_sampler
+{
+  const Program& prog;
+  const View& view;
+  bool deep;
+
+  vector< double > regs, out;
+  vector< DoubleDouble > regs_dd;
+
+public:
+  curve_sampler (const Program& prog, const View& view, bool deep)
+    : prog (prog), view (view), deep (deep),
+      regs (prog.get_num_nodes()), out (prog.get_num_outputs())
+  {
+    if (deep)
+      regs_dd.resize (prog.get_num_nodes());
+  }
+
+  void eval (double i)
+  {
+    if (!deep)
+    {
+      double x_y[2];
+      x_y[0] = view.horiz_px_to_pt (i);
+      x_y[1] = 0.0;
+      prog (x_y, &regs[0], &out[0]);
+
+      for (int k = 0; k < out.size(); k++)
+        out[k] = view.vert_pt_to_px (out[k]);
+      return;
+    }
+
+    DoubleDouble x_y[2];
+    x_y[0] = horiz_px_to_dd (view, i);
+    x_y[1] = DoubleDouble (0.0);
+    for (int deps = 0; deps < NUM_DEPS; deps++)
+      prog.eval_stage (deps, x_y, &regs_dd[0]);
+
+    for (int k = 0; k < out.size(); k++)
+    {
+      DoubleDouble dy = regs_dd[ prog.get_output_node (k) ] -
+                        DoubleDouble (view.center_y);
+      out[k] = view.height/2 - view.scale * dy.to_double();
+    }
+  }
+
+  // the row of curve k at the last column evaluated
+  double row (int k) const { return out[k]; }
+};
+
+#define MAX_CURVE_DEPTH 6   // steep segments are split down to 1/64 px
+
+// draws curve k between two samples, splitting the segment while it is
+// steeper than a pixel
+static void
+trace_segment (const curve_canvas& c, curve_sampler& sampler, int k,
+               const View& view,
+               double i0, double j0, double i1, double j1, int depth)
+{
+  if (!finite (j0) || !finite (j1))
+    return;
+
+  // both ends on the same side of the clip rectangle
+  if ((j0 < c.y0 - 1 && j1 < c.y0 - 1) || (j0 > c.y1 && j1 > c.y1))
+    return;
+
+  if (fabs (j1 - j0) <= 1.0 || depth == MAX_CURVE_DEPTH)
+  {
+    // still this steep at the finest level: a pole, like tan(x) has
+    if (fabs (j1 - j0) > view.height)
+      return;
+
+    draw_aa_line (c, i0, j0, i1, j1);
+    return;
+  }
+
+  double i_mid = (i0 + i1) / 2;
+  sampler.eval (i_mid);
+  double j_mid = sampler.row (k);
+
+  trace_segment (c, sampler, k, view, i0, j0, i_mid, j_mid, depth + 1);
+  trace_segment (c, sampler, k, view, i_mid, j_mid, i1, j1, depth + 1);
+}
+
+// the y = Y(x) equations: one evaluation per column, plus a few more
+// where the curve is steep, instead of one per pixel
+void
+render_explicit (const Program& y_prog, const View& view,
+                 const Canvas& canvas, int x, int y, int width, int height)
+{
+  int num_curves = y_prog.get_num_outputs();
+  if (num_curves == 0)
+    return;
+
+  curve_canvas c;
+  c.canvas = canvas;
+  c.x0 = x;
+  c.y0 = y;
+  c.x1 = x + width;
+  c.y1 = y + height;
+
+  // the curves can leave the rectangle vertically, so only the columns
+  // decide the precision
+  bool deep = !double_is_enough (view, x - 1, view.height/2, width + 2, 0);
+  curve_sampler sampler (y_prog, view, deep);
+
+  vector< double > prev_j (num_curves), cur_j (num_curves);
+
+  // one column past each side, so segments crossing the edges are drawn
+  for (int i = x - 1; i <= x + width; i++)
+  {
+    // the extra samples of steep segments reuse the sampler
+    sampler.eval (i);
+    for (int k = 0; k < num_curves; k++)
+      cur_j[k] = sampler.row (k);
+
+    for (int k = 0; k < num_curves; k++)
+    {
+      if (i > x - 1)
+        trace_segment (c, sampler, k, view, i - 1, prev_j[k], i, cur_j[k], 0);
+      prev_j[k] = cur_j[k];
+    }
+  }
+}
@@ -0,0 +1,104 @@
+#ifndef _RENDER_H_
+#define _RENDER_H_
+
+#include <vector>
+#include "func.h"
+#include "program.h"
+#include "view.h"
+#include "shade.h"
+
+// With PRECISION_AUTO a tile is evaluated in float if its coordinates
+// are small enough for float to tell its pixels apart, and the constants
+// and parameters of the program fit float too. That is all it looks at:
+// an equation that amplifies small differences, like x^20 or 1e4*x - 1e4,
+// can still lose detail in float that double would keep.
+enum precision_enum
+{
+  PRECISION_DOUBLE,   // evaluate everything in double
+  PRECISION_AUTO      // per pixel in float where that is enough (above)
+};
+
+// where to draw: pixels of pixel_size bytes, rows stride bytes apart.
+// The renderers write a shade level, 0 to 255, into the first byte of
+// each pixel; write_pixels() turns those into colors.
+//
+// The pixels are those of the whole view whatever part of it buf holds:
+// buf starts at view pixel (origin_x, origin_y), so a band of a big view
+// renders into a buffer of its own with the coordinates of the view.
+struct Canvas
+{
+  unsigned char *buf;
+  int stride, pixel_size;
+  int origin_x, origin_y;
+
+  Canvas (void) : origin_x (0), origin_y (0) {}
+
+  // the first byte of view pixel (i, j)
+  unsigned char *at (int i, int j) const
+  { return buf + (j - origin_y)*stride + (i - origin_x)*pixel_size; }
+};
+
+// the program render_implicit() expects for the equations F(x,y) = 0:
+// just F, or with a distance shader, each F followed by dF/dx and dF/dy
+Math::Program compile_implicit (const std::vector< Math::Function >& F,
+                                const Shader& shader);
+
+// the functions compile_implicit() compiles, derivatives and all
+std::vector< Math::Function >
+implicit_functions (const std::vector< Math::Function >& F,
+                    const Shader& shader);
+
+// everything that only depends on x or y, computed once per column/row
+// of a rectangle of a view
+struct Hoisted
+{
+  const Math::Program *prog;        // what it was computed for
+  int num_nodes;
+  View view;
+  int x, y, width, height;
+
+  std::vector< double > consts;     // the DEP_NONE nodes
+  int x_begin, num_x;
+  std::vector< double > x_cache;    // x-only node k at column i is at
+                                    // x_cache[k * width + i - x]
+  int y_begin, num_y;
+  std::vector< double > y_cache;    // the same, by row
+
+  Hoisted (void) { clear(); }
+
+  // to be called when the program it was computed for changes
+  void clear (void) { prog = NULL; }
+};
+
+// tests the equations of prog at every pixel of the rectangle
+// (x, y, width, height) of view, and shades each by how close to a curve
+// it is. The rectangle is split into 64x64 tiles, shared out between
+// num_threads threads: the caller's and those of a pool every call in
+// the process shares, kept from one call to the next.
+//
+// Given a Hoisted, the x-only and y-only values stay in it, and as long
+// as prog and the rectangle of view stay the same, only those depending
+// on a parameter are computed again: what an animated parameter costs
+// besides the pixels themselves.
+void render_implicit (const Math::Program& prog, const View& view,
+                      const Canvas& c, int x, int y, int width, int height,
+                      const Shader& shader,
+                      precision_enum precision = PRECISION_AUTO,
+                      int num_threads = 1, Hoisted *hoisted = NULL);
+
+// one thread per processor
+int default_num_threads (void);
+
+// true if nothing would be drawn in the rectangle of view, as far as
+// interval bounds over all of it can tell: every equation of prog stays
+// out of the shader's range, and every curve of y_prog out of the rows.
+// Never true with the distance shader, which has no such bound.
+bool view_is_empty (const Math::Program& prog, const Math::Program& y_prog,
+                    const View& view, int x, int y, int width, int height,
+                    const Shader& shader);
+
+// draws the curves y = Y(x) of y_prog into the same rectangle, on top
+void render_explicit (const Math::Program& y_prog, const View& view,
+                      const Canvas& c, int x, int y, int width, int height);
+
+#endif
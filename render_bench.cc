@@ -0,0 +1,171 @@
+/*
+ * render_bench: times the pixel renderer on a large buffer.
+ *
+ *   render_bench [-w width] [-h height] [-s scale] [-n runs]
+ *                [-j threads] [equation]
+ *
+ * The defaults are a 3840x2160 (4K) buffer and one thread per processor.
+ * The first two lines compare writing the pixels of an RGB buffer a
+ * column at a time, the way draw_graph used to, against a row at a
+ * time; the rest time each stage of a full frame. render_explicit is
+ * timed only if there is a y = f(x) curve.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <string>
+#include <vector>
+
+#include "func.h"
+#include "program.h"
+#include "eqtn.h"
+#include "view.h"
+#include "render.h"
+#include "shade.h"
+#include "pixels.h"
+
+using namespace std;
+using namespace Math;
+
+static void
+usage (void)
+{
+  fprintf (stderr,
+           "usage: render_bench [-w width] [-h height] [-s scale] [-n runs]\n"
+           "                    [-j threads] [equation]\n");
+  exit (1);
+}
+
+static double
+now (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// prints the best of the runs, which is the least disturbed
+static void
+report (const char *what, double best, int pixels)
+{
+  printf ("%-28s %8.2f ms  %8.1f Mpixel/s\n",
+          what, best * 1e3, pixels / best * 1e-6);
+}
+
+int
+main (int argc, char **argv)
+{
+  View view (3840, 2160, 400.0, 0.0, 0.0);
+  int runs = 5;
+  int threads = default_num_threads();
+
+  int opt;
+  while ((opt = getopt (argc, argv, "w:h:s:n:j:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'w': view.width  = atoi (optarg); break;
+      case 'h': view.height = atoi (optarg); break;
+      case 's': view.scale  = atof (optarg); break;
+      case 'n': runs        = atoi (optarg); break;
+      case 'j': threads     = atoi (optarg); break;
+      default:  usage();
+    }
+  }
+  if (argc - optind > 1 || view.width <= 0 || view.height <= 0 || runs <= 0)
+    usage();
+
+  string text = (optind < argc) ? argv[ optind ] :
+                "sin(x*y) = cos(x) + y; x^2 + y^2 = 9; y = x^3/9 - x";
+  vector< Function > F, Y;
+  try
+  {
+    compile_equations (text, F, Y);
+  }
+  catch (SyntaxException e)
+  {
+    fprintf (stderr, "syntax error at %d in \"%s\"\n", e.pos, text.c_str());
+    return 1;
+  }
+  catch (ArgumentException e)
+  {
+    fprintf (stderr, "bad argument at %d-%d in \"%s\"\n",
+             e.pos_start, e.pos_end, text.c_str());
+    return 1;
+  }
+
+  int w = view.width, h = view.height, pixels = w * h;
+  vector< unsigned char > levels (pixels), rgb (pixels * 3);
+
+  Canvas c;
+  c.buf = &levels[0];
+  c.stride = w;
+  c.pixel_size = 1;
+
+  Shader shader;
+  Colormap colors;
+  Program prog = compile_implicit (F, shader);
+  Program y_prog (Y);
+
+  printf ("%dx%d, %d equations, %d threads, best of %d\n",
+          w, h, (int) (F.size() + Y.size()), threads, runs);
+
+  double col_major = 1e300, row_major = 1e300, one = 1e300, many = 1e300;
+  double expl = 1e300, output = 1e300;
+  for (int r = 0; r < runs; r++)
+  {
+    // the same pixels, in the same format, in either order
+    double t0 = now();
+    for (int i = 0; i < w; i++)
+      for (int j = 0; j < h; j++)
+      {
+        unsigned char *p = &rgb[ (j * w + i) * 3 ];
+        p[0] = (unsigned char) (i ^ j);
+        p[1] = 0;
+        p[2] = 0;
+      }
+
+    double t1 = now();
+    for (int j = 0; j < h; j++)
+      for (int i = 0; i < w; i++)
+      {
+        unsigned char *p = &rgb[ (j * w + i) * 3 ];
+        p[0] = (unsigned char) (i ^ j);
+        p[1] = 0;
+        p[2] = 0;
+      }
+
+    double t2 = now();
+    render_implicit (prog, view, c, 0, 0, w, h, shader, PRECISION_AUTO, 1);
+
+    double t3 = now();
+    render_implicit (prog, view, c, 0, 0, w, h, shader, PRECISION_AUTO,
+                     threads);
+
+    double t4 = now();
+    render_explicit (y_prog, view, c, 0, 0, w, h);
+
+    double t5 = now();
+    write_pixels (c, 0, 0, w, h, colors, PIXEL_RGB, &rgb[0], w * 3);
+
+    double t6 = now();
+    col_major = min (col_major, t1 - t0);
+    row_major = min (row_major, t2 - t1);
+    one       = min (one, t3 - t2);
+    many      = min (many, t4 - t3);
+    expl      = min (expl, t5 - t4);
+    output    = min (output, t6 - t5);
+  }
+
+  report ("write, column-major", col_major, pixels);
+  report ("write, row-major", row_major, pixels);
+  report ("render_implicit, 1 thread", one, pixels);
+  report ("render_implicit, threaded", many, pixels);
+  if (!Y.empty())
+    report ("render_explicit", expl, pixels);
+  report ("write_pixels", output, pixels);
+
+  return 0;
+}
@@ -0,0 +1,278 @@
+#include "session.h"
+#include "parse.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+using namespace std;
+using namespace Math;
+
+// The session file is a line per setting, "name value":
+//
+//   grapher-session 1
+//   save_images 1
+//   window
+//   equation x^2 + y^2 = 9
+//   view 100 0 0
+//   ...
+//   end
+//
+// with a "window" ... "end" block for each window. Lines it doesn't know
+// are skipped, so settings can be added without a new version.
+
+#define SESSION_FILE   "session"
+#define EQUATIONS_FILE "equations.gfn"
+#define MAX_LINE       8192
+#define MAX_IMAGE_SIZE 16384   // pixels, each way
+
+static const char *shading_names[ NUM_SHADINGS ] = {
+  "gamma", "linear", "distance"
+};
+
+WindowState::WindowState (void)
+{
+  scale = 100.0;
+  center_x = center_y = 0.0;
+  x = y = width = height = -1;
+  grid = hud = false;
+  fast_eval = true;
+  shading = SHADE_GAMMA;
+  image_width = image_height = 0;
+}
+
+string
+default_session_dir (void)
+{
+  const char *home = getenv ("HOME");
+  return string (home ? home : ".") + "/.grapher";
+}
+
+static string
+image_name (int i)
+{
+  char buf[ 32 ];
+  sprintf (buf, "window-%d.pgm", i);
+  return buf;
+}
+
+// the levels as a binary PGM, which any image viewer shows
+static bool
+write_image (const string& fn, const WindowState& w)
+{
+  FILE *f = fopen (fn.c_str(), "wb");
+  if (!f)
+    return false;
+
+  fprintf (f, "P5\n%d %d\n255\n", w.image_width, w.image_height);
+  bool ok = fwrite (&w.image[0], 1, w.image.size(), f) == w.image.size();
+  return (fclose (f) == 0) && ok;
+}
+
+static bool
+read_image (const string& fn, WindowState& w)
+{
+  FILE *f = fopen (fn.c_str(), "rb");
+  if (!f)
+    return false;
+
+  int width, height, max_val;
+  bool ok = fscanf (f, "P5 %d %d %d", &width, &height, &max_val) == 3 &&
+            fgetc (f) != EOF &&   // the one space after the header
+            width > 0 && height > 0 && max_val == 255 &&
+            width <= MAX_IMAGE_SIZE && height <= MAX_IMAGE_SIZE;
+  if (ok)
+  {
+    w.image.resize (width * height);
+    ok = fread (&w.image[0], 1, w.image.size(), f) == w.image.size();
+    w.image_width = width;
+    w.image_height = height;
+  }
+  fclose (f);
+
+  if (!ok)
+  {
+    w.image.clear();
+    w.image_key = "";
+    w.image_width = w.image_height = 0;
+  }
+  return ok;
+}
+
+static void
+write_window (FILE *f, const WindowState& w, const string& image)
+{
+  fprintf (f, "window\n");
+  fprintf (f, "equation %s\n", w.equation.c_str());
+  fprintf (f, "view %.17g %.17g %.17g\n", w.scale, w.center_x, w.center_y);
+  fprintf (f, "geometry %d %d %d %d\n", w.x, w.y, w.width, w.height);
+  fprintf (f, "grid %d\n", w.grid);
+  fprintf (f, "hud %d\n", w.hud);
+  fprintf (f, "fast_eval %d\n", w.fast_eval);
+  fprintf (f, "shading %s\n", shading_names[ w.shading ]);
+  fprintf (f, "param %s\n", w.param.c_str());
+  fprintf (f, "param_from %s\n", w.param_from.c_str());
+  fprintf (f, "param_to %s\n", w.param_to.c_str());
+  for (int i = 0; i < w.bindings.size(); i++)
+    fprintf (f, "bind %s %.17g\n", var_names[ w.bindings[i].first ],
+             w.bindings[i].second);
+  if (!image.empty())
+    fprintf (f, "image %s %s\n", image.c_str(), w.image_key.c_str());
+  fprintf (f, "end\n");
+}
+
+bool
+save_session (const string& dir, const Session& s,
+              const vector< FunctionEntry >& equations)
+{
+  if (mkdir (dir.c_str(), 0777) != 0 && errno != EEXIST)
+    return false;
+
+  // written anew and moved over the old one: the old one may be mapped
+  // by whoever loaded it, and must not change under them
+  string eq_fn = dir + "/" + EQUATIONS_FILE;
+  if (!write_function_file ((eq_fn + ".new").c_str(), equations, false) ||
+      rename ((eq_fn + ".new").c_str(), eq_fn.c_str()) != 0)
+    return false;
+
+  string fn = dir + "/" + SESSION_FILE;
+  FILE *f = fopen ((fn + ".new").c_str(), "w");
+  if (!f)
+    return false;
+
+  fprintf (f, "grapher-session %d\n", SESSION_VERSION);
+  fprintf (f, "save_images %d\n", s.save_images);
+
+  int i;
+  for (i = 0; i < s.windows.size(); i++)
+  {
+    const WindowState& w = s.windows[i];
+    string image;
+    if (s.save_images && !w.image.empty())
+    {
+      image = image_name (i);
+      if (!write_image (dir + "/" + image, w))
+      {
+        fclose (f);
+        return false;
+      }
+    }
+    else
+      unlink ((dir + "/" + image_name (i)).c_str());
+
+    write_window (f, w, image);
+  }
+
+  // the images of windows closed since
+  while (unlink ((dir + "/" + image_name (i)).c_str()) == 0)
+    i++;
+
+  if (ferror (f))
+  {
+    fclose (f);
+    return false;
+  }
+  if (fclose (f) != 0)
+    return false;
+  return rename ((fn + ".new").c_str(), fn.c_str()) == 0;
+}
+
+// one "name value" line of a window into w
+static void
+read_setting (const string& dir, const char *name, const char *value,
+              WindowState& w)
+{
+  if (strcmp (name, "equation") == 0)
+    w.equation = value;
+  else if (strcmp (name, "view") == 0)
+    sscanf (value, "%lf %lf %lf", &w.scale, &w.center_x, &w.center_y);
+  else if (strcmp (name, "geometry") == 0)
+    sscanf (value, "%d %d %d %d", &w.x, &w.y, &w.width, &w.height);
+  else if (strcmp (name, "grid") == 0)
+    w.grid = atoi (value);
+  else if (strcmp (name, "hud") == 0)
+    w.hud = atoi (value);
+  else if (strcmp (name, "fast_eval") == 0)
+    w.fast_eval = atoi (value);
+  else if (strcmp (name, "shading") == 0)
+  {
+    for (int i = 0; i < NUM_SHADINGS; i++)
+      if (strcmp (value, shading_names[i]) == 0)
+        w.shading = (shading_enum) i;
+  }
+  else if (strcmp (name, "param") == 0)
+    w.param = value;
+  else if (strcmp (name, "param_from") == 0)
+    w.param_from = value;
+  else if (strcmp (name, "param_to") == 0)
+    w.param_to = value;
+  else if (strcmp (name, "bind") == 0)
+  {
+    char param[ 16 ];
+    double val;
+    if (sscanf (value, "%15s %lf", param, &val) != 2)
+      return;
+    for (int v = NUM_VARS; v < NUM_VALUES; v++)
+      if (strcmp (param, var_names[v]) == 0)
+        w.bindings.push_back (make_pair ((var_enum) v, val));
+  }
+  else if (strcmp (name, "image") == 0)
+  {
+    char image[ 64 ], key[ 64 ];
+    if (sscanf (value, "%63s %63s", image, key) != 2 ||
+        strchr (image, '/'))
+      return;
+    w.image_key = key;
+    read_image (dir + "/" + image, w);
+  }
+}
+
+bool
+load_session (const string& dir, Session& s, FunctionFile& library)
+{
+  FILE *f = fopen ((dir + "/" + SESSION_FILE).c_str(), "r");
+  if (!f)
+    return false;
+
+  char line[ MAX_LINE ];
+  int version;
+  if (!fgets (line, sizeof (line), f) ||
+      sscanf (line, "grapher-session %d", &version) != 1 ||
+      version != SESSION_VERSION)
+  {
+    fclose (f);
+    return false;
+  }
+
+  s = Session();
+  WindowState *w = NULL;
+  while (fgets (line, sizeof (line), f))
+  {
+    line[ strcspn (line, "\r\n") ] = '\0';
+    char *value = strchr (line, ' ');
+    if (value)
+      *value++ = '\0';
+    else
+      value = line + strlen (line);
+
+    if (strcmp (line, "window") == 0)
+    {
+      s.windows.push_back (WindowState());
+      w = &s.windows.back();
+    }
+    else if (strcmp (line, "end") == 0)
+      w = NULL;
+    else if (w)
+      read_setting (dir, line, value, *w);
+    else if (strcmp (line, "save_images") == 0)
+      s.save_images = atoi (value);
+  }
+  fclose (f);
+
+  // without the equations, they are parsed from their text instead
+  library.open ((dir + "/" + EQUATIONS_FILE).c_str());
+  return true;
+}
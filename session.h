@@ -0,0 +1,63 @@
+#ifndef _SESSION_H_
+#define _SESSION_H_
+
+#include <string>
+#include <vector>
+#include <utility>
+#include "func.h"
+#include "shade.h"
+#include "func_file.h"
+
+#define SESSION_VERSION 1
+
+// what a grapher window shows, enough to open it again as it was
+struct WindowState
+{
+  std::string equation;               // as in its entry; empty if none
+  double scale, center_x, center_y;
+  int x, y, width, height;            // of the window; -1 if not known
+  bool grid, hud, fast_eval;
+  shading_enum shading;
+
+  std::string param;                  // the parameter on the slider
+  std::string param_from, param_to;   // the slider's range, as typed
+  std::vector< std::pair< Math::var_enum, double > > bindings;
+
+  // the shade levels last drawn, and the key of what they show (see
+  // GraphArea::get_image_key()); empty if not kept
+  std::string image_key;
+  int image_width, image_height;
+  std::vector< unsigned char > image;
+
+  WindowState (void);
+};
+
+struct Session
+{
+  std::vector< WindowState > windows;
+  bool save_images;                   // keep the windows' images too
+
+  Session (void) { save_images = false; }
+};
+
+// the directory sessions are kept in unless told otherwise:
+// $HOME/.grapher
+std::string default_session_dir (void);
+
+// Writes s into dir, made if it doesn't exist: the windows as text in
+// "session", each image as a PGM, and the compiled equations, each
+// keyed by its text, in a function file, so that opening the session
+// again needs no parsing. The text is written to a new file, then moved
+// over the old one, so a failed save never loses the session before it.
+// Returns false, with errno set, if anything could not be written.
+bool save_session (const std::string& dir, const Session& s,
+                   const std::vector< FunctionEntry >& equations);
+
+// the session saved in dir, and its equations mapped into library
+// (left closed if they aren't there). An image that can't be read is
+// dropped, its window drawn anew. Returns false if there is no session
+// or it isn't one of this version.
+bool load_session (const std::string& dir, Session& s,
+                   FunctionFile& library);
+
+#endif
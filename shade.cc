@@ -0,0 +1,43 @@
+#include "shade.h"
+#include <math.h>
+
+// a pixel this many pixels from the curve is black with SHADE_DISTANCE
+#define DISTANCE_RANGE 1.5
+
+Shader::Shader (shading_enum curve)
+{
+  this->curve = curve;
+
+  double range = (curve == SHADE_DISTANCE) ? DISTANCE_RANGE : 1.0;
+  index_scale = TABLE_SIZE / range;
+  log_index = (curve == SHADE_GAMMA);
+
+  for (int i = 0; i < TABLE_SIZE; i++)
+  {
+    // the middle of the interval that maps to entry i, normalized
+    double t;
+    if (log_index)
+      t = ldexp (1.0 + ((i & ((1 << LOG_BITS) - 1)) + 0.5) / (1 << LOG_BITS),
+                 (i >> LOG_BITS) - LOG_OCTAVES);
+    else
+      t = (i + 0.5) / TABLE_SIZE;
+
+    double intensity;
+    switch (curve)
+    {
+      case SHADE_LINEAR:
+      case SHADE_DISTANCE:
+        intensity = 1.0 - t;
+        break;
+      case SHADE_GAMMA:
+      default:
+        // steepen the error curve
+        intensity = 1.0 - pow (t, 0.3);
+        break;
+    }
+
+    table[i] = (unsigned char) (intensity * 0xFF + 0.5);
+  }
+
+  table[ TABLE_SIZE ] = 0;
+}
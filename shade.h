@@ -0,0 +1,94 @@
+#ifndef _SHADE_H_
+#define _SHADE_H_
+
+#include <string.h>
+
+enum shading_enum
+{
+  SHADE_GAMMA,      // 1 - |F|^0.3, the original look
+  SHADE_LINEAR,     // 1 - |F|
+  SHADE_DISTANCE,   // by the distance to the curve, |F| / |grad F|
+  NUM_SHADINGS
+};
+
+// Maps how far a pixel is from a curve to its grey level. The curve is
+// sampled once into a table, so shading a pixel is a multiply, a
+// compare and a lookup instead of a pow().
+class Shader
+{
+public:
+  static const int TABLE_SIZE = 4096;
+
+  // the gamma curve is steepest at 0, where evenly spaced entries would
+  // be too coarse, so its table is indexed by the bits of the float
+  // instead: LOG_BITS bits of mantissa for each of the LOG_OCTAVES
+  // octaves below 1
+  static const int LOG_BITS    = 6;
+  static const int LOG_OCTAVES = TABLE_SIZE >> LOG_BITS;
+
+private:
+  shading_enum curve;
+  bool log_index;
+  float index_scale;                      // TABLE_SIZE / the input range
+  unsigned char table[ TABLE_SIZE + 1 ];  // the last entry is for
+                                          // anything out of range, or NaN
+
+  static int to_index (float d, float index_scale, bool log_index)
+  {
+    if (!log_index)
+    {
+      d *= index_scale;
+      return (d < TABLE_SIZE) ? (int)d : TABLE_SIZE;
+    }
+
+    int bits;
+    memcpy (&bits, &d, sizeof (bits));
+    int i = (bits >> (23 - LOG_BITS)) - ((127 - LOG_OCTAVES) << LOG_BITS);
+    i = (i < 0) ? 0 : i;                  // tinier than the table
+    return (d < 1.0f) ? i : TABLE_SIZE;
+  }
+
+public:
+  Shader (shading_enum curve = SHADE_GAMMA);
+
+  shading_enum get_curve (void) const { return curve; }
+
+  // whether the inputs are distances in pixels instead of |F|
+  bool uses_distance (void) const { return curve == SHADE_DISTANCE; }
+
+  // inputs from here on are black
+  double get_range (void) const { return TABLE_SIZE / index_scale; }
+
+  unsigned char operator() (double diff) const
+  {
+    // past the range of float, but not of the table
+    if (!log_index && !(diff < 1.0 / index_scale))
+      return table[ TABLE_SIZE ];
+    return table[ to_index ((float)diff, index_scale, log_index) ];
+  }
+
+  // n values at once; the index loop has no branches, so it vectorizes
+  template< class T >
+  void quantize (const T *diff, int n, unsigned char *out) const
+  {
+    int index[ 256 ];
+    for (int l0 = 0; l0 < n; l0 += 256)
+    {
+      int m = (n - l0 < 256) ? n - l0 : 256;
+      if (log_index)
+        for (int l = 0; l < m; l++)
+          index[l] = to_index ((float)diff[ l0 + l ], index_scale, true);
+      else
+        for (int l = 0; l < m; l++)
+        {
+          T d = diff[ l0 + l ] * (T)index_scale;
+          index[l] = (d < TABLE_SIZE) ? (int)d : TABLE_SIZE;
+        }
+
+      for (int l = 0; l < m; l++)
+        out[ l0 + l ] = table[ index[l] ];
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,328 @@
+#include "trace.h"
+#include "func.h"
+#include "program.h"
+#include "contour.h"
+#include "view.h"
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+using namespace Math;
+
+namespace {
+
+struct Point
+{
+  double x, y;
+
+  Point (void) {}
+  Point (double x, double y) { this->x = x; this->y = y; }
+};
+
+class Tracer
+{
+  Program prog;                 // F, dF/dx, dF/dy
+  vector< double > regs;
+  double out[3];
+
+  const View& view;
+  int coarse;
+  double step;                  // in points
+  double tolerance;             // how far off the curve a point may be
+
+  int cells_x, cells_y;
+  vector< vector< Point > > traced;  // the points so far, by coarse cell
+
+  bool eval (const Point& p);
+  bool project (Point& p);
+  bool tangent (const Point& p, const Point& prev_dir, Point& dir);
+  int  cell_of (const Point& p);
+  bool near_traced (const Point& p);
+  void follow (Point seed, double sign, vector< Point >& line);
+
+public:
+  vector< Polyline > lines;
+
+  Tracer (const Function& F, const View& view, int coarse, double step,
+          const double *params);
+  void trace_from (Point seed);
+  void run (void);
+};
+
+Tracer::Tracer (const Function& F, const View& view, int coarse, double step,
+                const double *params)
+  : view (view)
+{
+  prog.add (F);
+  prog.add (F.differentiate (var_x));
+  prog.add (F.differentiate (var_y));
+  regs.resize (prog.get_num_nodes());
+
+  for (int p = 0; params && p < NUM_PARAMS; p++)
+    prog.bind ((var_enum) (NUM_VARS + p), params[p]);
+
+  this->coarse = coarse;
+  this->step = step / view.scale;
+  tolerance = 0.01 / view.scale;
+
+  cells_x = (view.width  + coarse - 1) / coarse;
+  cells_y = (view.height + coarse - 1) / coarse;
+  traced.resize (cells_x * cells_y);
+}
+
+// F and its gradient at p into out[]; false if any of them is unusable
+bool
+Tracer::eval (const Point& p)
+{
+  double x_y[2] = { p.x, p.y };
+  prog (x_y, &regs[0], out);
+
+  return finite (out[0]) && finite (out[1]) && finite (out[2]) &&
+         (out[1] != 0.0 || out[2] != 0.0);
+}
+
+// moves p onto the curve with Newton's method
+bool
+Tracer::project (Point& p)
+{
+  for (int i = 0; i < 8; i++)
+  {
+    if (!eval (p))
+      return false;
+
+    double grad2 = out[1] * out[1] + out[2] * out[2];
+    double dist  = fabs (out[0]) / sqrt (grad2);
+    if (dist < tolerance)
+      return true;
+
+    p.x -= out[0] * out[1] / grad2;
+    p.y -= out[0] * out[2] / grad2;
+  }
+
+  return false;
+}
+
+// the unit tangent at p, pointing the same way as prev_dir
+bool
+Tracer::tangent (const Point& p, const Point& prev_dir, Point& dir)
+{
+  if (!eval (p))
+    return false;
+
+  double len = sqrt (out[1] * out[1] + out[2] * out[2]);
+  dir = Point (-out[2] / len, out[1] / len);
+
+  if (dir.x * prev_dir.x + dir.y * prev_dir.y < 0.0)
+    dir = Point (-dir.x, -dir.y);
+
+  return true;
+}
+
+// the points just outside the view go into the cells at its edges
+int
+Tracer::cell_of (const Point& p)
+{
+  double i = floor (view.horiz_pt_to_px (p.x) / coarse);
+  double j = floor (view.vert_pt_to_px  (p.y) / coarse);
+
+  i = max (0.0, min (i, cells_x - 1.0));
+  j = max (0.0, min (j, cells_y - 1.0));
+
+  return ((int)j) * cells_x + (int)i;
+}
+
+// whether p is on a curve that was already traced
+bool
+Tracer::near_traced (const Point& p)
+{
+  int i = cell_of (p) % cells_x;
+  int j = cell_of (p) / cells_x;
+
+  for (int cj = max (j - 1, 0); cj <= min (j + 1, cells_y - 1); cj++)
+    for (int ci = max (i - 1, 0); ci <= min (i + 1, cells_x - 1); ci++)
+    {
+      const vector< Point >& pts = traced[ cj * cells_x + ci ];
+      for (int k = 0; k < pts.size(); k++)
+      {
+        double dx = pts[k].x - p.x, dy = pts[k].y - p.y;
+        if (dx * dx + dy * dy < 2.25 * step * step)
+          return true;
+      }
+    }
+
+  return false;
+}
+
+// from seed along the curve, in the direction 'sign' of the tangent
+void
+Tracer::follow (Point seed, double sign, vector< Point >& line)
+{
+  double margin = 2 * coarse / view.scale;
+  double min_x = view.horiz_px_to_pt (0) - margin;
+  double max_x = view.horiz_px_to_pt (view.width) + margin;
+  double min_y = view.vert_px_to_pt (view.height) - margin;
+  double max_y = view.vert_px_to_pt (0) + margin;
+
+  int max_steps = 64 * (view.width + view.height);
+
+  Point p = seed, dir;
+  if (!eval (p))
+    return;
+
+  double len = sqrt (out[1] * out[1] + out[2] * out[2]);
+  dir = Point (-sign * out[2] / len, sign * out[1] / len);
+
+  double h = step;
+  for (int n = 0; n < max_steps; n++)
+  {
+    // predict along the tangent, correct back onto the curve
+    Point q (p.x + h * dir.x, p.y + h * dir.y);
+    Point new_dir;
+
+    bool ok = project (q) && tangent (q, dir, new_dir);
+    if (ok)
+    {
+      double dx = q.x - p.x, dy = q.y - p.y;
+      double dist2 = dx * dx + dy * dy;
+
+      // don't jump to another branch, or around a sharp corner
+      ok = dist2 < 4 * h * h && dist2 > 0.0 &&
+           dir.x * new_dir.x + dir.y * new_dir.y > 0.9;
+    }
+
+    if (!ok)
+    {
+      h /= 2;
+      if (h < step / 256)
+        return;
+      continue;
+    }
+
+    line.push_back (q);
+    p = q;
+    dir = new_dir;
+    h = min (2 * h, step);
+
+    if (p.x < min_x || p.x > max_x || p.y < min_y || p.y > max_y)
+      return;
+
+    // back to where it started: a closed curve
+    double dx = p.x - seed.x, dy = p.y - seed.y;
+    if (n > 2 && dx * dx + dy * dy < h * h)
+    {
+      line.push_back (seed);
+      return;
+    }
+  }
+}
+
+void
+Tracer::trace_from (Point seed)
+{
+  if (!project (seed) || near_traced (seed))
+    return;
+
+  vector< Point > fwd, bwd;
+  follow (seed, 1.0, fwd);
+
+  bool closed = !fwd.empty() &&
+                fwd.back().x == seed.x && fwd.back().y == seed.y;
+  if (!closed)
+    follow (seed, -1.0, bwd);
+
+  vector< Point > pts (bwd.rbegin(), bwd.rend());
+  pts.push_back (seed);
+  pts.insert (pts.end(), fwd.begin(), fwd.end());
+
+  Polyline line;
+  for (int i = 0; i < pts.size(); i++)
+  {
+    traced[ cell_of (pts[i]) ].push_back (pts[i]);
+
+    ContourPoint cp;
+    cp.x = view.horiz_pt_to_px (pts[i].x);
+    cp.y = view.vert_pt_to_px  (pts[i].y);
+    line.push_back (cp);
+  }
+
+  if (line.size() > 1)
+    lines.push_back (line);
+}
+
+void
+Tracer::run (void)
+{
+  double cell = coarse / view.scale;
+
+  // F and its gradient at the corners of the coarse grid
+  int corners_x = cells_x + 1, corners_y = cells_y + 1;
+  vector< double > value (corners_x * corners_y);
+  vector< double > dist  (corners_x * corners_y);
+  vector< Point >  pos   (corners_x * corners_y);
+
+  for (int j = 0; j < corners_y; j++)
+    for (int i = 0; i < corners_x; i++)
+    {
+      int k = j * corners_x + i;
+      pos[k] = Point (view.horiz_px_to_pt (i * coarse),
+                      view.vert_px_to_pt  (j * coarse));
+
+      if (eval (pos[k]))
+      {
+        value[k] = out[0];
+        dist[k]  = fabs (out[0]) / sqrt (out[1]*out[1] + out[2]*out[2]);
+      }
+      else
+      {
+        value[k] = out[0];
+        dist[k]  = HUGE_VAL;
+      }
+    }
+
+  for (int j = 0; j < corners_y; j++)
+    for (int i = 0; i < corners_x; i++)
+    {
+      int k = j * corners_x + i;
+
+      // sign changes along the edges to the right and below
+      if (i + 1 < corners_x && (value[k] >= 0.0) != (value[k + 1] >= 0.0))
+      {
+        double t = value[k] / (value[k] - value[k + 1]);
+        if (finite (t))
+          trace_from (Point (pos[k].x + t * (pos[k + 1].x - pos[k].x),
+                             pos[k].y));
+      }
+
+      int below = k + corners_x;
+      if (j + 1 < corners_y && (value[k] >= 0.0) != (value[below] >= 0.0))
+      {
+        double t = value[k] / (value[k] - value[below]);
+        if (finite (t))
+          trace_from (Point (pos[k].x,
+                             pos[k].y + t * (pos[below].y - pos[k].y)));
+      }
+
+      // curves too thin to change sign between corners
+      if (dist[k] < cell)
+        trace_from (pos[k]);
+    }
+}
+
+} // namespace
+
+vector< Polyline >
+trace_contours (const vector< Function >& F, const View& view,
+                int coarse, double step, const double *params)
+{
+  vector< Polyline > lines;
+
+  for (int k = 0; k < F.size(); k++)
+  {
+    Tracer t (F[k], view, coarse, step, params);
+    t.run();
+    lines.insert (lines.end(), t.lines.begin(), t.lines.end());
+  }
+
+  return lines;
+}
@@ -0,0 +1,24 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <vector>
+#include "func.h"
+#include "contour.h"
+#include "view.h"
+
+// The zero sets of the functions in F over view, followed point by point.
+// Curves are seeded where F changes sign along the edges of a grid of
+// coarse x coarse pixel cells (or where a corner is within a cell of
+// the curve by F / |grad F|), and then traced with steps of at most
+// 'step' pixels: a step along the tangent, followed by Newton's method on
+// F using the exact partial derivatives. The points are on the curve to
+// well within a pixel, and the number of evaluations follows the length
+// of the curves rather than the area of the view. params holds the
+// values of the NUM_PARAMS parameters, or is NULL for all 0.
+std::vector< Polyline > trace_contours (const std::vector< Math::Function >& F,
+                                        const View& view,
+                                        int coarse = 16,
+                                        double step = 1.0,
+                                        const double *params = NULL);
+
+#endif
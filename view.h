@@ -0,0 +1,39 @@
+#ifndef _VIEW_H_
+#define _VIEW_H_
+
+// A width x height pixel window onto the plane, with (center_x, center_y)
+// at its middle and 'scale' pixels per unit. Pixel (i, j) covers the
+// point horiz_px_to_pt (i), vert_px_to_pt (j); rows grow downwards.
+struct View
+{
+  int width, height;
+  double scale;
+  double center_x, center_y;
+
+  View (void) {}
+  View (int width, int height, double scale,
+        double center_x, double center_y)
+  {
+    this->width    = width;
+    this->height   = height;
+    this->scale    = scale;
+    this->center_x = center_x;
+    this->center_y = center_y;
+  }
+
+  // pixels to logical points
+  double horiz_px_to_pt (double x) const
+  { return (x - width/2) / scale + center_x; }
+
+  double  vert_px_to_pt (double y) const
+  { return (height/2 - y) / scale + center_y; }
+
+  // logical points to pixels
+  double horiz_pt_to_px (double x) const
+  { return scale * (x - center_x) + width/2; }
+
+  double  vert_pt_to_px (double y) const
+  { return height/2 - scale * (y - center_y); }
+};
+
+#endif